@@ -0,0 +1,115 @@
+// a user program for testing copy-on-write fork: children see the
+// parent's memory, their writes stay private, and forking a big
+// process takes little memory until someone writes
+// usage: cowtest
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NPAGES  512   // 2MB of memory to share
+#define NCHILD  8
+#define PGSIZE  4096
+
+int
+main(int argc, char *argv[])
+{
+    char *mem;
+    int i, j, fd, pid, before, shared;
+
+    mem = sbrk(NPAGES * PGSIZE);
+    if(mem == (char*)-1)
+    {
+        printf(2, "cowtest: sbrk failed\n");
+        exit();
+    }
+    for(i = 0; i < NPAGES; i++)
+        mem[i * PGSIZE] = i;
+
+    // A child that only reads should not cost a copy of the pages.
+    before = freepages();
+    pid = fork();
+    if(pid < 0)
+    {
+        printf(2, "cowtest: fork failed\n");
+        exit();
+    }
+    if(pid == 0)
+    {
+        for(i = 0; i < NPAGES; i++)
+        {
+            if(mem[i * PGSIZE] != (char)i)
+            {
+                printf(2, "cowtest: child read %d at page %d\n",
+                       mem[i * PGSIZE], i);
+                exit();
+            }
+        }
+        exit();
+    }
+    shared = before - freepages();
+    wait();
+    printf(1, "fork of %d pages took %d pages\n", NPAGES, shared);
+    if(shared >= NPAGES)
+    {
+        printf(2, "cowtest: fork copied the pages\n");
+        exit();
+    }
+
+    // Children that write get their own copies.
+    for(j = 0; j < NCHILD; j++)
+    {
+        pid = fork();
+        if(pid < 0)
+        {
+            printf(2, "cowtest: fork failed\n");
+            exit();
+        }
+        if(pid == 0)
+        {
+            for(i = 0; i < NPAGES; i++)
+                mem[i * PGSIZE] = j;
+            for(i = 0; i < NPAGES; i++)
+            {
+                if(mem[i * PGSIZE] != (char)j)
+                {
+                    printf(2, "cowtest: child %d lost a write\n", j);
+                    exit();
+                }
+            }
+            exit();
+        }
+    }
+    for(j = 0; j < NCHILD; j++)
+        wait();
+
+    for(i = 0; i < NPAGES; i++)
+    {
+        if(mem[i * PGSIZE] != (char)i)
+        {
+            printf(2, "cowtest: parent sees %d at page %d\n",
+                   mem[i * PGSIZE], i);
+            exit();
+        }
+    }
+
+    // The kernel writes to shared pages too, e.g. in read().
+    pid = fork();
+    if(pid == 0)
+    {
+        fd = open("README", 0);
+        if(fd < 0 || read(fd, mem, 64) != 64 || mem[0] == 0)
+            printf(2, "cowtest: read into shared page failed\n");
+        close(fd);
+        exit();
+    }
+    wait();
+    if(mem[0] != 0)
+    {
+        printf(2, "cowtest: child's read changed parent memory\n");
+        exit();
+    }
+
+    printf(1, "cowtest ok\n");
+    exit();
+}
@@ -0,0 +1,26 @@
+// an user program for showing per-cpu scheduler statistics
+// usage: cpustat [-r]   (-r resets the counters after printing)
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+int main(int argc, char *argv[])
+{
+    cpu_info cpu_infos[NCPU];
+    int i, n, reset;
+
+    reset = (argc > 1 && strcmp(argv[1], "-r") == 0);
+    n = cpustat(cpu_infos, NCPU, reset);
+
+    printf(1, "cpu \t picks \t cycles/pick \t idle ticks\n");
+    for(i = 0; i < n; i++)
+    {
+        printf(1, "%d \t %d \t %d \t\t %d\n", cpu_infos[i].cpu,
+               cpu_infos[i].picks,
+               cpu_infos[i].picks ? cpu_infos[i].pickcycles / cpu_infos[i].picks : 0,
+               cpu_infos[i].idleticks);
+    }
+    exit();
+}
@@ -2,9 +2,11 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct kcache;
 struct pipe;
 struct proc;
 struct rtcdate;
+struct rusage;
 struct spinlock;
 struct sleeplock;
 struct stat;
@@ -40,6 +42,8 @@ int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
+void            ideny(struct inode*);
+void            iallow(struct inode*);
 void            iinit(int dev);
 void            ilock(struct inode*);
 void            iput(struct inode*);
@@ -52,6 +56,7 @@ struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, char*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
+char*           itextpage(struct inode*, uint, uint);
 
 // ide.c
 void            ideinit(void);
@@ -66,9 +71,28 @@ void            ioapicinit(void);
 // kalloc.c
 char*           kalloc(void);
 void            kfree(char*);
+char*           kzalloc(void);
+int             kprezero(void);
+void            kdup(char*);
+int             kowners(char*);
+char*           kallocorder(int);
+void            kfreeorder(char*, int);
+int             kmemstat(uint*, int);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
 
+// shm.c
+void            shminit(void);
+int             kshmget(int, uint);
+int             kshmat(int);
+int             kshmdt(uint);
+int             kshmrm(int);
+
+// slab.c
+void            kcacheinit(struct kcache*, char*, uint);
+void*           kcachealloc(struct kcache*);
+void            kcachefree(struct kcache*, void*);
+
 // kbd.c
 void            kbdintr(void);
 
@@ -77,6 +101,7 @@ void            cmostime(struct rtcdate *r);
 int             lapicid(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
+void            lapicipi(int, int);
 void            lapicinit(void);
 void            lapicstartap(uchar, uint);
 void            microdelay(int);
@@ -95,7 +120,19 @@ void            mpinit(void);
 void            picenable(int);
 void            picinit(void);
 
+// mmap.c
+void            mmapinit(void);
+int             kmmap(uint, int, int, struct file*, uint);
+int             kmunmap(uint, uint);
+void            munmapall(struct proc*);
+int             mmapfork(struct proc*);
+int             mmapfault(uint);
+int             mmapcovers(struct proc*, uint, uint);
+uint            mmapbase(struct proc*);
+uint            mmaplen(struct proc*, uint);
+
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, char*, int);
@@ -112,10 +149,8 @@ struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
 void            procdump(void);
-void            main_scheduler(void) __attribute__((noreturn));
-void            test_scheduler(void) __attribute__((noreturn));
-void            priority_scheduler(void) __attribute__((noreturn));
-void            mlq_scheduler(void) __attribute__((noreturn));
+void            scheduler(void) __attribute__((noreturn));
+int             timeslice(struct proc*);
 void            sched(void);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
@@ -126,9 +161,17 @@ void            yield(void);
 void            kproc_dump(proc_info proc_infos[], int n);
 void            kcps(void);
 int             kchpr(int pid, int priority);
-int             kwaitx(int*, int*);
+int             kwaitx(int*, int*, int*, struct rusage*);
+int             kgetrusage(int, struct rusage*);
 int             kset_priority(int);
+int             kchsched(int);
+int             ksettickets(int);
+int             ksetdeadline(int, int, int);
+int             ksetaffinity(int, uint);
+int             kgetaffinity(int);
 void            updateStatistics();
+int             kcpustat(cpu_info cpu_infos[], int n, int reset);
+int             kschedlat(uint*, int, int, int);
 
 // swtch.S
 void            swtch(struct context**, struct context*);
@@ -159,7 +202,7 @@ char*           strncpy(char*, const char*, int);
 
 // syscall.c
 int             argint(int, int*);
-int             argptr(int, char**, int);
+int             argptr(int, char**, int, int);
 int             argstr(int, char**);
 int             fetchint(uint, int*);
 int             fetchstr(uint, char**);
@@ -171,6 +214,7 @@ void            timerinit(void);
 // trap.c
 void            idtinit(void);
 extern uint     ticks;
+extern uint     tscpertick;
 void            tvinit(void);
 extern struct spinlock tickslock;
 
@@ -193,6 +237,12 @@ pde_t*          copyuvm(pde_t*, uint);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
+int             cowfault(pde_t*, uint);
+int             uvmshare(pde_t*, pde_t*, uint, uint, int);
+pte_t*          walkpgdir(pde_t*, const void*, int);
+int             mappages(pde_t*, void*, uint, uint, int);
+int             pagein(uint);
+int             uvmtouch(uint, uint, int);
 void            clearpteu(pde_t *pgdir, char *uva);
 
 // number of elements in fixed-size array
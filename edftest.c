@@ -0,0 +1,86 @@
+// a user program for EDF_SCHEDULER: deadline processes with
+// different periods share the cpu with a best-effort spinner,
+// and report how many of their jobs missed the deadline.
+// run "sched edf" first.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NCHILD 3
+#define PERIODS 20   // jobs per deadline process
+
+// ticks of work each job does, per period. They reserve one
+// tick more, as a job rarely starts right at a tick.
+static int runtime[NCHILD] = {2, 3, 5};
+static int period[NCHILD]  = {10, 15, 25};
+
+// spin for about n ticks of cpu time
+static void
+work(int n)
+{
+    int start = uptime();
+
+    while(uptime() - start < n)
+        ;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int pids[NCHILD + 1];
+    int i, j, pid, wtime, rtime, misses;
+
+    for(i = 0; i < NCHILD; i++)
+    {
+        pids[i] = fork();
+        if(pids[i] < 0)
+        {
+            printf(2, "edftest: fork failed\n");
+            exit();
+        }
+        if(pids[i] == 0)
+        {
+            if(setdeadline(runtime[i] + 1, period[i], period[i]) < 0)
+            {
+                printf(2, "edftest: setdeadline rejected\n");
+                exit();
+            }
+            for(j = 0; j < PERIODS; j++)
+            {
+                int start = uptime();
+                work(runtime[i]);
+                sleep(period[i] - (uptime() - start));
+            }
+            exit();
+        }
+    }
+
+    // a best-effort process competing with them
+    pids[NCHILD] = fork();
+    if(pids[NCHILD] == 0)
+    {
+        work(PERIODS * 10);
+        exit();
+    }
+
+    // admission control: the children reserve 300+266+240 = 806
+    // thousandths of a cpu, so a whole cpu more is rejected below
+    // three cpus (1806 > 2*900) and admitted from three on.
+    sleep(2);
+    printf(1, "reserving a whole cpu as well: %s\n",
+           setdeadline(10, 10, 10) == 0 ? "admitted" : "rejected");
+    setdeadline(0, 0, 0);
+
+    for(i = 0; i < NCHILD + 1; i++)
+    {
+        if((pid = waitdl(&wtime, &rtime, &misses)) < 0)
+            break;
+        for(j = 0; j < NCHILD + 1; j++)
+            if(pids[j] == pid)
+                printf(1, "pid %d: %s, rtime %d, wtime %d, %d misses\n",
+                       pid, j < NCHILD ? "deadline" : "best effort",
+                       rtime, wtime, misses);
+    }
+    exit();
+}
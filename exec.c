@@ -14,8 +14,10 @@ exec(char *path, char **argv)
   int i, off;
   uint argc, sz, sp, ustack[3+MAXARG+1];
   struct elfhdr elf;
-  struct inode *ip;
+  struct inode *ip, *execip, *oldip;
   struct proghdr ph;
+  struct execseg seg[NEXECSEG];
+  int nseg;
   pde_t *pgdir, *oldpgdir;
   struct proc *curproc = myproc();
 
@@ -28,6 +30,7 @@ exec(char *path, char **argv)
   }
   ilock(ip);
   pgdir = 0;
+  execip = 0;
 
   // Check ELF header
   if(readi(ip, (char*)&elf, 0, sizeof(elf)) != sizeof(elf))
@@ -38,8 +41,12 @@ exec(char *path, char **argv)
   if((pgdir = setupkvm()) == 0)
     goto bad;
 
-  // Load program into memory.
+  // Load program into memory. The first NEXECSEG segments
+  // are only recorded, and pagein reads their pages from the
+  // file when they are first touched; that needs ip, so we
+  // keep our reference to it.
   sz = 0;
+  nseg = 0;
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, (char*)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -49,15 +56,36 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr + ph.memsz < ph.vaddr)
       goto bad;
-    if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
-      goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
+    if(nseg < NEXECSEG){
+      if(ph.vaddr + ph.memsz >= KERNBASE)
+        goto bad;
+      if(ph.vaddr + ph.memsz > sz)
+        sz = ph.vaddr + ph.memsz;
+      seg[nseg].va = ph.vaddr;
+      seg[nseg].off = ph.off;
+      seg[nseg].filesz = ph.filesz;
+      seg[nseg].writable = (ph.flags & ELF_PROG_FLAG_WRITE) != 0;
+      nseg++;
+      continue;
+    }
+    if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
+      goto bad;
     if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
       goto bad;
   }
-  iunlockput(ip);
+  if(nseg > 0)
+    ideny(ip);
+  iunlock(ip);
   end_op();
+  if(nseg > 0)
+    execip = ip;
+  else {
+    begin_op();
+    iput(ip);
+    end_op();
+  }
   ip = 0;
 
   // Allocate two pages at the next page boundary.
@@ -94,13 +122,24 @@ exec(char *path, char **argv)
   safestrcpy(curproc->name, last, sizeof(curproc->name));
 
   // Commit to the user image.
+  munmapall(curproc);
   oldpgdir = curproc->pgdir;
+  oldip = curproc->execip;
   curproc->pgdir = pgdir;
   curproc->sz = sz;
+  curproc->execip = execip;
+  curproc->nseg = nseg;
+  memmove(curproc->seg, seg, sizeof(seg));
   curproc->tf->eip = elf.entry;  // main
   curproc->tf->esp = sp;
   switchuvm(curproc);
   freevm(oldpgdir);
+  if(oldip){
+    iallow(oldip);
+    begin_op();
+    iput(oldip);
+    end_op();
+  }
   return 0;
 
  bad:
@@ -110,5 +149,11 @@ exec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  if(execip){
+    iallow(execip);
+    begin_op();
+    iput(execip);
+    end_op();
+  }
   return -1;
 }
@@ -14,6 +14,8 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  int nexec;          // processes paging their program in from it
+  struct inode *next; // icache list
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -23,6 +25,7 @@ struct inode {
   short nlink;
   uint size;
   uint addrs[NDIRECT+1];
+  struct textpage *text; // pages of the file cached for exec
 };
 
 // table mapping major device number to
@@ -0,0 +1,59 @@
+// a user program for measuring fork: how fast processes can be
+// created and reaped one after another, and how many can be alive
+// at once now that the process table grows on demand
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define NSERIAL 5000   // fork/exit/wait rounds
+
+static int pids[NPROC];
+
+int
+main(int argc, char *argv[])
+{
+    int i, n, pid, start;
+
+    start = uptime();
+    for(i = 0; i < NSERIAL; i++)
+    {
+        pid = fork();
+        if(pid < 0)
+        {
+            printf(2, "forkbench: fork %d failed\n", i);
+            exit();
+        }
+        if(pid == 0)
+            exit();
+        wait();
+    }
+    printf(1, "%d fork/exit/wait: %d ticks\n", NSERIAL, uptime() - start);
+
+    // Children sleep until the parent is done, so they pile up.
+    start = uptime();
+    for(n = 0; n < NPROC; n++)
+    {
+        pid = fork();
+        if(pid < 0)
+            break;
+        pids[n] = pid;
+        if(pid == 0)
+        {
+            sleep(1000000);
+            exit();
+        }
+    }
+    printf(1, "%d children alive at once: %d ticks to fork\n",
+           n, uptime() - start);
+
+    // Killing them all leaves n zombies to reap.
+    start = uptime();
+    for(i = 0; i < n; i++)
+        kill(pids[i]);
+    for(i = 0; i < n; i++)
+        wait();
+    printf(1, "killed and reaped them: %d ticks\n", uptime() - start);
+    exit();
+}
@@ -20,6 +20,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "slab.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 static void itrunc(struct inode*);
@@ -154,8 +155,10 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The icache.lock spin-lock protects the allocation of icache
-// entries. Since ip->ref indicates whether an entry is free,
+// In-memory inodes come from a slab cache and are on icache.list
+// for as long as ip->ref > 0; at most NINODE of them at once.
+// The icache.lock spin-lock protects the list and the allocation
+// of entries. Since ip->ref indicates whether an entry is free,
 // and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold icache.lock while using any of those fields.
 //
@@ -165,18 +168,30 @@ bfree(int dev, uint b)
 
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *list;
+  int ninode;
+  struct kcache cache;
 } icache;
 
+// A page of a program file, shared by all the processes that
+// run it (see pagein in vm.c). It holds len bytes of the file
+// from off, then zeros. The inode's text list, protected by
+// ip->lock, holds one reference to each page.
+struct textpage {
+  struct textpage *next;
+  uint off;
+  uint len;
+  char *page;
+};
+
+static struct kcache textcache;
+
 void
 iinit(int dev)
 {
-  int i = 0;
-  
   initlock(&icache.lock, "icache");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&icache.inode[i].lock, "inode");
-  }
+  kcacheinit(&icache.cache, "inode", sizeof(struct inode));
+  kcacheinit(&textcache, "textpage", sizeof(struct textpage));
 
   readsb(dev, &sb);
   cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
@@ -186,6 +201,7 @@ iinit(int dev)
 }
 
 static struct inode* iget(uint dev, uint inum);
+static void itextdrop(struct inode*);
 
 //PAGEBREAK!
 // Allocate an inode on device dev.
@@ -241,31 +257,33 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip;
 
   acquire(&icache.lock);
 
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+  for(ip = icache.list; ip; ip = ip->next){
+    if(ip->dev == dev && ip->inum == inum){
       ip->ref++;
       release(&icache.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
+  // Allocate a new inode cache entry.
+  if(icache.ninode >= NINODE || (ip = kcachealloc(&icache.cache)) == 0)
     panic("iget: no inodes");
 
-  ip = empty;
+  initsleeplock(&ip->lock, "inode");
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
+  ip->nexec = 0;
   ip->valid = 0;
+  ip->text = 0;
+  ip->next = icache.list;
+  icache.list = ip;
+  icache.ninode++;
   release(&icache.lock);
 
   return ip;
@@ -282,6 +300,29 @@ idup(struct inode *ip)
   return ip;
 }
 
+// A process whose program is ip reads the pages it has not
+// touched yet from the file (see pagein in vm.c), so the file
+// must not change under it: writei fails while ip->nexec > 0.
+// exec and fork count a process in with ideny, and exec and exit
+// count it out with iallow. ideny is called with ip->lock held
+// or with nexec already nonzero, so a writei that found it zero
+// finishes before a process that could see its data starts.
+void
+ideny(struct inode *ip)
+{
+  acquire(&icache.lock);
+  ip->nexec++;
+  release(&icache.lock);
+}
+
+void
+iallow(struct inode *ip)
+{
+  acquire(&icache.lock);
+  ip->nexec--;
+  release(&icache.lock);
+}
+
 // Lock the given inode.
 // Reads the inode from disk if necessary.
 void
@@ -322,8 +363,8 @@ iunlock(struct inode *ip)
 }
 
 // Drop a reference to an in-memory inode.
-// If that was the last reference, the inode cache entry can
-// be recycled.
+// If that was the last reference, the inode cache entry is
+// freed.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -331,6 +372,8 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
+  struct inode **pp;
+
   acquiresleep(&ip->lock);
   if(ip->valid && ip->nlink == 0){
     acquire(&icache.lock);
@@ -347,10 +390,66 @@ iput(struct inode *ip)
   releasesleep(&ip->lock);
 
   acquire(&icache.lock);
-  ip->ref--;
+  if(--ip->ref == 0){
+    for(pp = &icache.list; *pp != ip; pp = &(*pp)->next)
+      ;
+    *pp = ip->next;
+    icache.ninode--;
+    itextdrop(ip);
+    kcachefree(&icache.cache, ip);
+  }
   release(&icache.lock);
 }
 
+// Return a page holding the len bytes of ip from off, followed
+// by zeros, shared with everyone else who asked for the same.
+// The caller gets a reference to it, to drop with kfree.
+// Returns 0 if the file can't be read or memory is short.
+// Caller must hold ip->lock.
+char*
+itextpage(struct inode *ip, uint off, uint len)
+{
+  struct textpage *tp;
+  char *mem;
+
+  if(len > PGSIZE)
+    panic("itextpage");
+  for(tp = ip->text; tp; tp = tp->next)
+    if(tp->off == off && tp->len == len)
+      break;
+  if(tp == 0){
+    if((mem = kzalloc()) == 0)
+      return 0;
+    if(readi(ip, mem, off, len) != len ||
+       (tp = kcachealloc(&textcache)) == 0){
+      kfree(mem);
+      return 0;
+    }
+    tp->off = off;
+    tp->len = len;
+    tp->page = mem;
+    tp->next = ip->text;
+    ip->text = tp;
+  }
+  kdup(tp->page);
+  return tp->page;
+}
+
+// Forget ip's cached text pages, which the file no longer
+// matches. Processes that map them keep their references.
+// Caller must hold ip->lock, or the last reference to ip.
+static void
+itextdrop(struct inode *ip)
+{
+  struct textpage *tp;
+
+  while((tp = ip->text) != 0){
+    ip->text = tp->next;
+    kfree(tp->page);
+    kcachefree(&textcache, tp);
+  }
+}
+
 // Common idiom: unlock, then put.
 void
 iunlockput(struct inode *ip)
@@ -411,6 +510,10 @@ itrunc(struct inode *ip)
   struct buf *bp;
   uint *a;
 
+  // Every process running ip holds a reference to it.
+  if(ip->nexec)
+    panic("itrunc: text busy");
+  itextdrop(ip);
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
       bfree(ip->dev, ip->addrs[i]);
@@ -495,6 +598,15 @@ writei(struct inode *ip, char *src, uint off, uint n)
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
+  if(n > 0){
+    acquire(&icache.lock);
+    if(ip->nexec > 0){
+      release(&icache.lock);
+      return -1;    // a running program
+    }
+    release(&icache.lock);
+    itextdrop(ip);
+  }
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
     bp = bread(ip->dev, bmap(ip, off/BSIZE));
     m = min(n - tot, BSIZE - off%BSIZE);
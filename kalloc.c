@@ -1,6 +1,7 @@
 // Physical memory allocator, intended to allocate
 // memory for user processes, kernel stacks, page table pages,
-// and pipe buffers. Allocates 4096-byte pages.
+// and pipe buffers. Allocates 4096-byte pages, and blocks of
+// 2^order contiguous pages with kallocorder().
 
 #include "types.h"
 #include "defs.h"
@@ -15,12 +16,54 @@ extern char end[]; // first address after kernel loaded from ELF file
 
 struct run {
   struct run *next;
+  struct run *prev;   // buddy lists only
+};
+
+// Free memory is managed by a buddy allocator: a free block of
+// 2^k pages starts at a physical address that is a multiple of
+// its size, and sits on freelist[k]. Allocation splits the
+// smallest big enough block in halves; freeing merges a block
+// with its buddy, the other half of the block of twice the size,
+// for as long as that buddy is free too. order[] remembers, per
+// physical page, k+1 if a free block of order k starts there.
+//
+// Each cpu also keeps its own list of free pages, so that kalloc
+// and kfree usually take only that cpu's lock, which no other cpu
+// wants. Pages move between a cpu's list and the buddy allocator
+// KBATCH at a time: a cpu with no free pages refills from the
+// buddy allocator, or, if that is empty too, steals half the pages
+// of the cpu that has most; a cpu with more than KHIGH free pages
+// drains its coldest KBATCH back to the buddy allocator.
+//
+// Idle cpus zero free pages ahead of time and keep up to KZERO
+// of them on a list, from which kzalloc takes pages that need
+// to start out zeroed, such as page tables and new user memory.
+#define KBATCH 32
+#define KHIGH  (4*KBATCH)
+#define KZERO  64
+
+struct kcpu {
+  struct spinlock lock;
+  struct run *freelist;
+  int nfree;
 };
 
 struct {
   struct spinlock lock;
   int use_lock;
-  struct run *freelist;
+  struct run *freelist[MAXORDER+1];  // free blocks of each order
+  uint nblocks[MAXORDER+1];          // how many there are
+  uchar order[PHYSTOP/PGSIZE];
+  struct run *zerolist;              // zeroed free pages
+  int nzero;
+  struct spinlock reflock;           // protects ref[]
+  // A user page shared copy-on-write after fork has more than one
+  // owner. ref[] counts the extra ones, so that kalloc need not
+  // touch it and kfree only frees a page when it drops to zero.
+  // A page with no extra owners can't gain one under a kfree of
+  // it, so kfree reads ref[] without the lock in the common case.
+  ushort ref[PHYSTOP/PGSIZE];
+  struct kcpu cpu[NCPU];
 } kmem;
 
 // Initialization happens in two phases.
@@ -31,11 +74,18 @@ struct {
 void
 kinit1(void *vstart, void *vend)
 {
+  int i;
+
   initlock(&kmem.lock, "kmem");
+  initlock(&kmem.reflock, "kref");
+  for(i = 0; i < NCPU; i++)
+    initlock(&kmem.cpu[i].lock, "kmemcpu");
   kmem.use_lock = 0;
   freerange(vstart, vend);
 }
 
+// Until kinit2 is done only one cpu runs and mycpu() may not work
+// yet, so kalloc and kfree use the buddy allocator without locks.
 void
 kinit2(void *vstart, void *vend)
 {
@@ -51,6 +101,149 @@ freerange(void *vstart, void *vend)
   for(; p + PGSIZE <= (char*)vend; p += PGSIZE)
     kfree(p);
 }
+
+// Buddy allocator helpers. Caller must hold kmem.lock.
+
+static void
+pushblock(struct run *r, int k)
+{
+  r->prev = 0;
+  r->next = kmem.freelist[k];
+  if(r->next)
+    r->next->prev = r;
+  kmem.freelist[k] = r;
+  kmem.nblocks[k]++;
+  kmem.order[V2P(r)/PGSIZE] = k+1;
+}
+
+static void
+popblock(struct run *r, int k)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.freelist[k] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.nblocks[k]--;
+  kmem.order[V2P(r)/PGSIZE] = 0;
+}
+
+// Allocate a block of 2^k pages, or return 0.
+static struct run*
+buddyalloc(int k)
+{
+  struct run *r;
+  int j;
+
+  for(j = k; j <= MAXORDER && kmem.freelist[j] == 0; j++)
+    ;
+  if(j > MAXORDER)
+    return 0;
+  r = kmem.freelist[j];
+  popblock(r, j);
+  // Split, keeping the lower half and freeing the upper one.
+  while(j > k){
+    j--;
+    pushblock((struct run*)((char*)r + (PGSIZE << j)), j);
+  }
+  return r;
+}
+
+// Free the block of 2^k pages at v, merging it with its buddies.
+static void
+buddyfree(char *v, int k)
+{
+  uint pa, buddy;
+
+  pa = V2P(v);
+  for(; k < MAXORDER; k++){
+    buddy = pa ^ (PGSIZE << k);
+    if(buddy >= PHYSTOP || kmem.order[buddy/PGSIZE] != k+1)
+      break;
+    popblock((struct run*)P2V(buddy), k);
+    pa &= ~(PGSIZE << k);
+  }
+  pushblock((struct run*)P2V(pa), k);
+}
+
+// Take a page off the zeroed list, or return 0.
+static struct run*
+takezero(void)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  if((r = kmem.zerolist) != 0){
+    kmem.zerolist = r->next;
+    kmem.nzero--;
+    r->next = 0;
+  }
+  release(&kmem.lock);
+  return r;
+}
+
+// Unlink the first n pages of *list, which must hold that many,
+// and return them as a chain ending at *tail.
+static struct run*
+takepages(struct run **list, int n, struct run **tail)
+{
+  struct run *head, *r;
+
+  head = r = *list;
+  while(--n > 0)
+    r = r->next;
+  *list = r->next;
+  r->next = 0;
+  *tail = r;
+  return head;
+}
+
+// Give kc a batch of free pages from the buddy allocator, or else
+// half of those of the cpu with the most. Called without kc->lock.
+static void
+refill(struct kcpu *kc)
+{
+  struct run *head, *tail, *r;
+  struct kcpu *v, *victim;
+  int n;
+
+  head = tail = 0;
+  acquire(&kmem.lock);
+  for(n = 0; n < KBATCH && (r = buddyalloc(0)) != 0; n++){
+    if(tail == 0)
+      tail = r;
+    r->next = head;
+    head = r;
+  }
+  release(&kmem.lock);
+
+  if(n == 0){
+    // nfree without the lock is only a hint; check again below.
+    victim = 0;
+    for(v = kmem.cpu; v < &kmem.cpu[NCPU]; v++)
+      if(v != kc && v->nfree > (victim ? victim->nfree : 0))
+        victim = v;
+    if(victim == 0)
+      return;
+    acquire(&victim->lock);
+    n = (victim->nfree + 1) / 2;
+    if(n > 0){
+      head = takepages(&victim->freelist, n, &tail);
+      victim->nfree -= n;
+    }
+    release(&victim->lock);
+    if(n == 0)
+      return;
+  }
+
+  acquire(&kc->lock);
+  tail->next = kc->freelist;
+  kc->freelist = head;
+  kc->nfree += n;
+  release(&kc->lock);
+}
+
 //PAGEBREAK: 21
 // Free the page of physical memory pointed at by v,
 // which normally should have been returned by a
@@ -59,21 +252,61 @@ freerange(void *vstart, void *vend)
 void
 kfree(char *v)
 {
-  struct run *r;
+  struct run *r, *head, *tail;
+  struct kcpu *kc;
+  int n;
 
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
 
+  // Just drop a reference to a page that is still shared.
+  if(kmem.ref[V2P(v)/PGSIZE] > 0){
+    acquire(&kmem.reflock);
+    if(kmem.ref[V2P(v)/PGSIZE] > 0){
+      kmem.ref[V2P(v)/PGSIZE]--;
+      release(&kmem.reflock);
+      return;
+    }
+    release(&kmem.reflock);
+  }
+
+#if KJUNK
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
+#endif
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
   r = (struct run*)v;
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  if(kmem.use_lock)
-    release(&kmem.lock);
+  if(!kmem.use_lock){
+    buddyfree(v, 0);
+    return;
+  }
+
+  pushcli();
+  kc = &kmem.cpu[cpuid()];
+  acquire(&kc->lock);
+  r->next = kc->freelist;
+  kc->freelist = r;
+  if(++kc->nfree <= KHIGH){
+    release(&kc->lock);
+    popcli();
+    return;
+  }
+
+  // Too many: drain the KBATCH least recently freed ones,
+  // at the end of the list.
+  for(r = kc->freelist, n = kc->nfree - KBATCH; n > 1; n--)
+    r = r->next;
+  head = takepages(&r->next, KBATCH, &tail);
+  kc->nfree -= KBATCH;
+  release(&kc->lock);
+  popcli();
+
+  acquire(&kmem.lock);
+  while((r = head) != 0){
+    head = r->next;
+    buddyfree((char*)r, 0);
+  }
+  release(&kmem.lock);
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -83,14 +316,141 @@ char*
 kalloc(void)
 {
   struct run *r;
+  struct kcpu *kc;
+
+  if(!kmem.use_lock)
+    return (char*)buddyalloc(0);
+
+  // Interrupts stay off so that we stay on this cpu.
+  pushcli();
+  kc = &kmem.cpu[cpuid()];
+  if(kc->freelist == 0)
+    refill(kc);
+  acquire(&kc->lock);
+  r = kc->freelist;
+  if(r){
+    kc->freelist = r->next;
+    kc->nfree--;
+  }
+  release(&kc->lock);
+  popcli();
+  if(r == 0)
+    r = takezero();
+  return (char*)r;
+}
+
+// Allocate a page that is filled with zeros.
+char*
+kzalloc(void)
+{
+  char *v;
+
+  if(kmem.use_lock && (v = (char*)takezero()) != 0)
+    return v;
+  if((v = kalloc()) != 0)
+    memset(v, 0, PGSIZE);
+  return v;
+}
+
+// Zero one free page for kzalloc, if there are too few.
+// Called by idle cpus; returns 1 if it did any work.
+int
+kprezero(void)
+{
+  struct run *r;
+
+  // nzero without the lock is only a hint.
+  if(!kmem.use_lock || kmem.nzero >= KZERO)
+    return 0;
+  if((r = (struct run*)kalloc()) == 0)
+    return 0;
+  memset(r, 0, PGSIZE);
+  acquire(&kmem.lock);
+  r->next = kmem.zerolist;
+  kmem.zerolist = r;
+  kmem.nzero++;
+  release(&kmem.lock);
+  return 1;
+}
+
+// Add an owner to the page at v; kfree must then be
+// called once more before the page is freed.
+void
+kdup(char *v)
+{
+  if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
+    panic("kdup");
+  acquire(&kmem.reflock);
+  kmem.ref[V2P(v)/PGSIZE]++;
+  release(&kmem.reflock);
+}
+
+// Return the number of owners of the page at v.
+int
+kowners(char *v)
+{
+  return kmem.ref[V2P(v)/PGSIZE] + 1;
+}
+
+// Allocate 2^order physically contiguous pages, aligned to their
+// size. Returns 0 if there is no free block that large.
+char*
+kallocorder(int order)
+{
+  char *v;
+
+  if(order < 0 || order > MAXORDER)
+    return 0;
+  if(order == 0)
+    return kalloc();
 
   if(kmem.use_lock)
     acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
+  v = (char*)buddyalloc(order);
+  if(kmem.use_lock)
+    release(&kmem.lock);
+  return v;
+}
+
+// Free a block that kallocorder(order) returned.
+void
+kfreeorder(char *v, int order)
+{
+  if(order == 0){
+    kfree(v);
+    return;
+  }
+  if(order < 0 || order > MAXORDER || V2P(v) % (PGSIZE << order) ||
+     v < end || V2P(v) + (PGSIZE << order) > PHYSTOP)
+    panic("kfreeorder");
+
+#if KJUNK
+  // Fill with junk to catch dangling refs.
+  memset(v, 1, PGSIZE << order);
+#endif
+
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  buddyfree(v, order);
   if(kmem.use_lock)
     release(&kmem.lock);
-  return (char*)r;
 }
 
+// Copy the number of free blocks of each order, up to n orders,
+// into nblocks, and return the number of free pages that are
+// cached on the cpus' lists or the zeroed list.
+int
+kmemstat(uint *nblocks, int n)
+{
+  int i, cached;
+
+  acquire(&kmem.lock);
+  for(i = 0; i < n && i <= MAXORDER; i++)
+    nblocks[i] = kmem.nblocks[i];
+  cached = kmem.nzero;
+  release(&kmem.lock);
+
+  for(i = 0; i < NCPU; i++)
+    cached += kmem.cpu[i].nfree;
+  return cached;
+}
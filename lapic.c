@@ -113,6 +113,20 @@ lapiceoi(void)
     lapicw(EOI, 0);
 }
 
+// Send an inter-processor interrupt with the given vector
+// to the cpu whose local APIC id is apicid.
+// Interrupts must be off, so the two ICR writes are not split.
+void
+lapicipi(int apicid, int vector)
+{
+  if(!lapic)
+    return;
+  lapicw(ICRHI, apicid<<24);
+  lapicw(ICRLO, FIXED | ASSERT | vector);
+  while(lapic[ICRLO] & DELIVS)
+    ;
+}
+
 // Spin for a given number of microseconds.
 // On real hardware would want to tune this dynamically.
 void
@@ -0,0 +1,83 @@
+// a user program for testing lazy sbrk: memory costs nothing
+// until it is touched, reads as zeros, and works as a system
+// call buffer and across fork before it is touched
+// usage: lazytest
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define BIG     (64*1024*1024)
+#define PGSIZE  4096
+
+static void
+fail(char *what)
+{
+    printf(2, "lazytest: %s\n", what);
+    exit();
+}
+
+int
+main(int argc, char *argv[])
+{
+    char *mem, ok;
+    int i, fd, pid, before, used, pfd[2];
+
+    before = freepages();
+    mem = sbrk(BIG);
+    if(mem == (char*)-1)
+        fail("sbrk failed");
+    used = before - freepages();
+    printf(1, "sbrk of %d pages took %d pages\n", BIG / PGSIZE, used);
+    if(used > 16)
+        fail("sbrk allocated eagerly");
+
+    // Touch one byte every 1MB.
+    for(i = 0; i < BIG; i += 1024*1024)
+    {
+        if(mem[i] != 0)
+            fail("new memory not zero");
+        mem[i] = 1;
+    }
+
+    // The kernel writes to untouched memory.
+    fd = open("README", 0);
+    if(fd < 0 || read(fd, mem + BIG - 2*PGSIZE + 100, 2*PGSIZE - 100) <= 0)
+        fail("read into untouched memory failed");
+    close(fd);
+
+    // A child gets the touched pages and can touch the rest.
+    // It reports what it saw through a pipe.
+    if(pipe(pfd) < 0)
+        fail("pipe failed");
+    pid = fork();
+    if(pid < 0)
+        fail("fork failed");
+    if(pid == 0)
+    {
+        ok = mem[1024*1024] == 1 && mem[1024*1024 + PGSIZE] == 0;
+        mem[PGSIZE] = 2;
+        write(pfd[1], &ok, 1);
+        exit();
+    }
+    if(read(pfd[0], &ok, 1) != 1 || !ok)
+        fail("child sees wrong memory");
+    wait();
+    close(pfd[0]);
+    close(pfd[1]);
+    if(mem[PGSIZE] != 0)
+        fail("child's write leaked into parent");
+
+    // Give it back; the pages we touched should be freed,
+    // though the page tables stay.
+    sbrk(-BIG);
+    used = before - freepages();
+    if(used > BIG / (PGSIZE*1024) + 16)
+    {
+        printf(2, "lazytest: %d pages not freed\n", used);
+        exit();
+    }
+
+    printf(1, "lazytest ok\n");
+    exit();
+}
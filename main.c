@@ -5,7 +5,6 @@
 #include "mmu.h"
 #include "proc.h"
 #include "x86.h"
-#include "scheduler.h"
 
 static void startothers(void);
 // static void mpmain(void)  __attribute__((noreturn));
@@ -13,14 +12,6 @@ static void mpmain(void);
 extern pde_t *kpgdir;
 extern char end[]; // first address after kernel loaded from ELF file
 
-// array of schedulers
-static void (*schedulers[])(void) = {
-[MAIN_SCHEDULER]      main_scheduler,
-[TEST_SCHEDULER]      test_scheduler,
-[PRIORITY_SCHEDULER]  priority_scheduler,
-[MLQ_SCHEDULER]       mlq_scheduler,
-};
-
 // Bootstrap processor starts running C code here.
 // Allocate a real stack and switch to it, first
 // doing some setup required for memory allocator to work.
@@ -40,6 +31,9 @@ main(void)
   tvinit();        // trap vectors
   binit();         // buffer cache
   fileinit();      // file table
+  pipeinit();      // pipe cache
+  mmapinit();      // vma cache
+  shminit();       // shared memory segments
   ideinit();       // disk 
   startothers();   // start other processors
   kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
@@ -64,7 +58,7 @@ mpmain(void)
   cprintf("cpu%d: starting %d\n", cpuid(), cpuid());
   idtinit();       // load idt register
   xchg(&(mycpu()->started), 1); // tell startothers() we're up
-  schedulers[SCHEDULER]();  // start running processes
+  scheduler();     // start running processes
 }
 
 pde_t entrypgdir[];  // For entry.S
@@ -0,0 +1,50 @@
+// a user program for showing how free physical memory is split
+// up: the number of free blocks of each order in the buddy
+// allocator, and how much of the free memory could still be
+// handed out in blocks of at least that order
+// usage: memstat
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+int
+main(int argc, char *argv[])
+{
+    uint nblocks[MAXORDER+1];
+    uint pages, total, above;
+    int k, cached, largest;
+
+    cached = memstat(nblocks, MAXORDER+1);
+    if(cached < 0)
+    {
+        printf(2, "memstat: failed\n");
+        exit();
+    }
+
+    total = 0;
+    largest = -1;
+    for(k = 0; k <= MAXORDER; k++)
+    {
+        total += nblocks[k] << k;
+        if(nblocks[k])
+            largest = k;
+    }
+
+    printf(1, "order blocks pages usable\n");
+    above = total;
+    for(k = 0; k <= MAXORDER; k++)
+    {
+        pages = nblocks[k] << k;
+        // usable: percentage of free pages in blocks of order >= k
+        printf(1, "%d %d %d %d%%\n", k, nblocks[k], pages,
+               total ? above * 100 / total : 0);
+        above -= pages;
+    }
+    printf(1, "free pages: %d, plus %d cached\n", total, cached);
+    if(largest >= 0)
+        printf(1, "largest free block: order %d (%d pages)\n",
+               largest, 1 << largest);
+    exit();
+}
@@ -0,0 +1,9 @@
+// mmap protection and flags
+#define PROT_READ      0x1
+#define PROT_WRITE     0x2
+
+#define MAP_SHARED     0x01  // writes go to the file and to children
+#define MAP_PRIVATE    0x02  // writes stay in this process
+#define MAP_ANONYMOUS  0x20  // zero filled memory, no file
+
+#define MAP_FAILED     ((void*)-1)
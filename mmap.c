@@ -0,0 +1,426 @@
+// Memory mapped files and anonymous memory.
+//
+// Each process has a list of virtual memory areas (vmas), the
+// regions that mmap gave it, sorted from the highest address
+// down. They are placed top down from KERNBASE, in the first gap
+// that fits, and sbrk can't grow into the lowest of them. Like
+// memory from sbrk, their pages are only allocated when first
+// touched: pagein calls mmapfault, which zero fills them or
+// reads them from the file with readi.
+//
+// munmap, exit and exec unmap a region's pages, writing the
+// ones the process dirtied back to the file if it is a shared
+// mapping of one. fork gives the child the parent's regions:
+// private ones copy-on-write, shared ones really shared. The
+// pages of a shared region that nobody had touched at fork are
+// still shared when they are: fork gives the region a vmobj,
+// which parent and child fault them in from.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "stat.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "slab.h"
+#include "mman.h"
+
+// The pages of a shared region that its processes have faulted
+// in since fork, kept at their addresses in a page table of their
+// own. It holds one reference to each page, and each process
+// that maps one another.
+struct vmobj {
+  struct sleeplock lock;  // protects everything here
+  int ref;                // vmas that use it
+  pde_t *pgdir;
+};
+
+struct vma {
+  struct vma *next;
+  uint start;           // page aligned
+  uint end;
+  int prot;             // PROT_READ, PROT_WRITE
+  int flags;            // MAP_SHARED or MAP_PRIVATE, MAP_ANONYMOUS
+  struct file *f;       // mapped file, or 0
+  uint off;             // file offset of start
+  struct vmobj *obj;    // shared region's pages, or 0
+};
+
+static struct kcache vmacache;
+static struct kcache vmobjcache;
+
+void
+mmapinit(void)
+{
+  kcacheinit(&vmacache, "vma", sizeof(struct vma));
+  kcacheinit(&vmobjcache, "vmobj", sizeof(struct vmobj));
+}
+
+static struct vmobj*
+objalloc(void)
+{
+  struct vmobj *o;
+
+  if((o = kcachealloc(&vmobjcache)) == 0)
+    return 0;
+  if((o->pgdir = (pde_t*)kzalloc()) == 0){
+    kcachefree(&vmobjcache, o);
+    return 0;
+  }
+  initsleeplock(&o->lock, "vmobj");
+  o->ref = 1;
+  return o;
+}
+
+static struct vmobj*
+objdup(struct vmobj *o)
+{
+  acquiresleep(&o->lock);
+  o->ref++;
+  releasesleep(&o->lock);
+  return o;
+}
+
+static void
+objput(struct vmobj *o)
+{
+  int r;
+
+  acquiresleep(&o->lock);
+  r = --o->ref;
+  releasesleep(&o->lock);
+  if(r == 0){
+    freevm(o->pgdir);
+    kcachefree(&vmobjcache, o);
+  }
+}
+
+// Return p's vma holding va, or 0.
+static struct vma*
+findvma(struct proc *p, uint va)
+{
+  struct vma *v;
+
+  for(v = p->vmas; v; v = v->next)
+    if(va >= v->start && va < v->end)
+      return v;
+  return 0;
+}
+
+// Lowest address mapped by p, or KERNBASE; the heap ends below.
+uint
+mmapbase(struct proc *p)
+{
+  struct vma *v;
+
+  for(v = p->vmas; v && v->next; v = v->next)
+    ;
+  return v ? v->start : KERNBASE;
+}
+
+// Return the length of p's region that starts at va, or 0.
+uint
+mmaplen(struct proc *p, uint va)
+{
+  struct vma *v;
+
+  if((v = findvma(p, va)) == 0 || v->start != va)
+    return 0;
+  return v->end - v->start;
+}
+
+// Return 1 if [va, va+n) lies within one of p's regions.
+int
+mmapcovers(struct proc *p, uint va, uint n)
+{
+  struct vma *v;
+
+  if(va + n < va || (v = findvma(p, va)) == 0)
+    return 0;
+  return va + n <= v->end;
+}
+
+// Write the page at mem, which maps va of v, back to the file.
+static void
+writeback(struct vma *v, uint va, char *mem)
+{
+  struct inode *ip = v->f->ip;
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * 512;
+  uint off, n, i, n1;
+
+  off = v->off + (va - v->start);
+  ilock(ip);
+  n = ip->size > off ? ip->size - off : 0;
+  iunlock(ip);
+  if(n > PGSIZE)
+    n = PGSIZE;
+
+  // A few blocks per transaction, as in filewrite.
+  for(i = 0; i < n; i += n1){
+    n1 = n - i;
+    if(n1 > max)
+      n1 = max;
+    begin_op();
+    ilock(ip);
+    writei(ip, mem + i, off + i, n1);
+    iunlock(ip);
+    end_op();
+  }
+}
+
+// Unmap [start, end) of v from p, writing back dirty pages
+// of a shared file mapping.
+static void
+unmappages(struct proc *p, struct vma *v, uint start, uint end)
+{
+  pte_t *pte;
+  uint a;
+  char *mem;
+
+  for(a = start; a < end; a += PGSIZE){
+    if((pte = walkpgdir(p->pgdir, (char*)a, 0)) == 0)
+      continue;
+    if((*pte & PTE_P) == 0)
+      continue;
+    mem = P2V(PTE_ADDR(*pte));
+    if(v->f && (v->flags & MAP_SHARED) && (*pte & PTE_D))
+      writeback(v, a, mem);
+    kfree(mem);
+    *pte = 0;
+  }
+  if(p == myproc())
+    lcr3(V2P(p->pgdir));
+}
+
+static void
+freevma(struct vma *v)
+{
+  if(v->f)
+    fileclose(v->f);
+  if(v->obj)
+    objput(v->obj);
+  kcachefree(&vmacache, v);
+}
+
+// Map len bytes of f from off, or anonymous memory if f is 0,
+// into the current process. Returns the address, or -1.
+int
+kmmap(uint len, int prot, int flags, struct file *f, uint off)
+{
+  struct proc *curproc = myproc();
+  struct vma *v, *nv, **pp;
+  uint end;
+
+  len = PGROUNDUP(len);
+  if(len == 0 || len > KERNBASE || off % PGSIZE)
+    return -1;
+  if((flags & (MAP_SHARED|MAP_PRIVATE)) == 0 ||
+     (flags & (MAP_SHARED|MAP_PRIVATE)) == (MAP_SHARED|MAP_PRIVATE))
+    return -1;
+  if(f){
+    if(f->type != FD_INODE || !f->readable)
+      return -1;
+    if((flags & MAP_SHARED) && (prot & PROT_WRITE) && !f->writable)
+      return -1;
+    ilock(f->ip);
+    if(f->ip->type != T_FILE){
+      iunlock(f->ip);
+      return -1;
+    }
+    iunlock(f->ip);
+  }
+
+  // First gap from the top that fits, above the heap.
+  end = KERNBASE;
+  for(pp = &curproc->vmas; (v = *pp) != 0; pp = &v->next){
+    if(end - v->end >= len)
+      break;
+    end = v->start;
+  }
+  if(end - PGROUNDUP(curproc->sz) < len || end < PGROUNDUP(curproc->sz))
+    return -1;
+
+  if((nv = kcachealloc(&vmacache)) == 0)
+    return -1;
+  nv->start = end - len;
+  nv->end = end;
+  nv->prot = prot;
+  nv->flags = flags;
+  nv->f = f ? filedup(f) : 0;
+  nv->off = off;
+  nv->obj = 0;
+  nv->next = v;
+  *pp = nv;
+  return nv->start;
+}
+
+// Unmap [va, va+len) of the current process, which may cover
+// parts of several regions.
+int
+kmunmap(uint va, uint len)
+{
+  struct proc *curproc = myproc();
+  struct vma *v, *nv, **pp;
+  uint end, s, e;
+
+  if(va % PGSIZE)
+    return -1;
+  end = va + PGROUNDUP(len);
+  if(end < va || end > KERNBASE)
+    return -1;
+
+  for(pp = &curproc->vmas; (v = *pp) != 0; ){
+    if(v->end <= va || v->start >= end){
+      pp = &v->next;
+      continue;
+    }
+    s = v->start > va ? v->start : va;
+    e = v->end < end ? v->end : end;
+    if(s > v->start && e < v->end){
+      // A hole in the middle: split off the upper part, which
+      // comes first in the list.
+      if((nv = kcachealloc(&vmacache)) == 0)
+        return -1;
+      *nv = *v;
+      nv->start = e;
+      nv->off = v->off + (e - v->start);
+      if(nv->f)
+        filedup(nv->f);
+      if(nv->obj)
+        objdup(nv->obj);
+      v->end = e;
+      *pp = nv;
+      nv->next = v;
+      pp = &nv->next;
+    }
+    unmappages(curproc, v, s, e);
+    if(s == v->start && e == v->end){
+      *pp = v->next;
+      freevma(v);
+      continue;
+    }
+    if(s == v->start){
+      v->off += e - v->start;
+      v->start = e;
+    } else
+      v->end = s;
+    pp = &v->next;
+  }
+  return 0;
+}
+
+// Unmap all of p's regions, as on exit and exec.
+void
+munmapall(struct proc *p)
+{
+  struct vma *v;
+
+  while((v = p->vmas) != 0){
+    p->vmas = v->next;
+    unmappages(p, v, v->start, v->end);
+    freevma(v);
+  }
+}
+
+// Give np copies of the current process's regions, sharing
+// the pages np->pgdir doesn't have yet. A shared region gets a
+// vmobj first, if it has none, so that parent and child find
+// the pages either of them touches later there. Returns -1 if
+// out of memory, leaving what was copied for munmapall.
+int
+mmapfork(struct proc *np)
+{
+  struct proc *curproc = myproc();
+  struct vma *v, *nv, **pp;
+
+  pp = &np->vmas;
+  for(v = curproc->vmas; v; v = v->next){
+    if((v->flags & MAP_SHARED) && v->obj == 0 &&
+       (v->obj = objalloc()) == 0)
+      return -1;
+    if((nv = kcachealloc(&vmacache)) == 0)
+      return -1;
+    *nv = *v;
+    nv->next = 0;
+    if(nv->f)
+      filedup(nv->f);
+    if(nv->obj)
+      objdup(nv->obj);
+    *pp = nv;
+    pp = &nv->next;
+    if(uvmshare(curproc->pgdir, np->pgdir, v->start, v->end,
+                v->flags & MAP_SHARED) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+// A new page holding what v has at va: the file's contents
+// there, or zeros. Returns 0 if it can't be had.
+static char*
+fillpage(struct vma *v, uint va)
+{
+  char *mem;
+  uint off;
+
+  if((mem = kzalloc()) == 0)
+    return 0;
+  if(v->f){
+    // Past the end of the file reads as zeros.
+    off = v->off + (va - v->start);
+    ilock(v->f->ip);
+    if(off < v->f->ip->size && readi(v->f->ip, mem, off, PGSIZE) < 0){
+      iunlock(v->f->ip);
+      kfree(mem);
+      return 0;
+    }
+    iunlock(v->f->ip);
+  }
+  return mem;
+}
+
+// Map the page at va, if the current process mapped it but
+// hasn't touched it yet. Returns -1 if va isn't in a region
+// or the page can't be had.
+int
+mmapfault(uint va)
+{
+  struct proc *curproc = myproc();
+  struct vma *v;
+  char *mem;
+  pte_t *pte;
+
+  if((v = findvma(curproc, va)) == 0 || !(v->prot & (PROT_READ|PROT_WRITE)))
+    return -1;
+  va = PGROUNDDOWN(va);
+  if(v->obj){
+    // Someone sharing the region may have the page already.
+    acquiresleep(&v->obj->lock);
+    if((pte = walkpgdir(v->obj->pgdir, (char*)va, 1)) == 0){
+      releasesleep(&v->obj->lock);
+      return -1;
+    }
+    if(*pte & PTE_P)
+      mem = P2V(PTE_ADDR(*pte));
+    else if((mem = fillpage(v, va)) != 0)
+      *pte = V2P(mem) | PTE_P;
+    if(mem)
+      kdup(mem);
+    releasesleep(&v->obj->lock);
+  } else
+    mem = fillpage(v, va);
+  if(mem == 0)
+    return -1;
+  if(mappages(curproc->pgdir, (char*)va, PGSIZE, V2P(mem),
+              PTE_U | ((v->prot & PROT_WRITE) ? PTE_W : 0)) < 0){
+    kfree(mem);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,183 @@
+// a user program for testing mmap and munmap: anonymous and file
+// mappings, private and shared, across fork, and partial unmaps
+// usage: mmaptest
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "mman.h"
+
+#define PGSIZE  4096
+
+static void
+fail(char *what)
+{
+    printf(2, "mmaptest: %s\n", what);
+    exit();
+}
+
+// Make a file of n pages, page i filled with 'a'+i.
+static void
+makefile(char *name, int n)
+{
+    char buf[PGSIZE];
+    int fd, i;
+
+    unlink(name);
+    if((fd = open(name, O_CREATE|O_RDWR)) < 0)
+        fail("create");
+    for(i = 0; i < n; i++)
+    {
+        memset(buf, 'a' + i, PGSIZE);
+        if(write(fd, buf, PGSIZE) != PGSIZE)
+            fail("write");
+    }
+    close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+    char *p, *q, c;
+    int fd, i, pfd[2];
+
+    // Anonymous private memory is zeroed and private to a child.
+    p = mmap(0, 4*PGSIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED)
+        fail("anonymous mmap");
+    for(i = 0; i < 4*PGSIZE; i++)
+        if(p[i] != 0)
+            fail("anonymous memory not zero");
+    p[0] = 1;
+    if(fork() == 0)
+    {
+        p[0] = 2;
+        exit();
+    }
+    wait();
+    if(p[0] != 1)
+        fail("private write leaked from child");
+    if(munmap(p, 4*PGSIZE) < 0)
+        fail("munmap");
+
+    // Anonymous shared memory is shared with a child.
+    p = mmap(0, PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED)
+        fail("shared mmap");
+    p[0] = 1;
+    if(fork() == 0)
+    {
+        p[0] = 2;
+        exit();
+    }
+    wait();
+    if(p[0] != 2)
+        fail("shared write not seen by parent");
+    munmap(p, PGSIZE);
+
+    // Even if neither touched it before the fork.
+    p = mmap(0, 2*PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED)
+        fail("shared mmap");
+    if(fork() == 0)
+    {
+        p[0] = 3;
+        p[PGSIZE] = 4;
+        exit();
+    }
+    wait();
+    if(p[0] != 3 || p[PGSIZE] != 4)
+        fail("untouched shared page not shared");
+    munmap(p, 2*PGSIZE);
+
+    // Without fork faulting in the rest of a big, sparse region.
+    p = mmap(0, 1024*PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED)
+        fail("shared mmap");
+    i = freepages();
+    if(fork() == 0)
+    {
+        p[512*PGSIZE] = 5;
+        exit();
+    }
+    wait();
+    if(i - freepages() > 16)
+        fail("fork faulted in a shared region");
+    if(p[512*PGSIZE] != 5)
+        fail("untouched shared page not shared");
+    munmap(p, 1024*PGSIZE);
+
+    // A private file mapping reads the file but doesn't write it.
+    makefile("mmapfile", 3);
+    if((fd = open("mmapfile", O_RDWR)) < 0)
+        fail("open");
+    p = mmap(0, 3*PGSIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(p == MAP_FAILED)
+        fail("file mmap");
+    for(i = 0; i < 3; i++)
+        if(p[i*PGSIZE] != 'a' + i || p[i*PGSIZE + PGSIZE-1] != 'a' + i)
+            fail("file contents");
+    p[0] = 'x';
+    munmap(p, 3*PGSIZE);
+    if(read(fd, &c, 1) != 1 || c != 'a')
+        fail("private write reached the file");
+
+    // A shared file mapping writes dirty pages back on munmap,
+    // and unmapping the middle page leaves the others.
+    p = mmap(0, 3*PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if(p == MAP_FAILED)
+        fail("shared file mmap");
+    p[0] = 'X';
+    p[2*PGSIZE] = 'Z';
+    if(munmap(p + PGSIZE, PGSIZE) < 0)
+        fail("munmap middle");
+    if(p[0] != 'X' || p[2*PGSIZE] != 'Z')
+        fail("munmap of the middle lost the rest");
+    munmap(p, 3*PGSIZE);
+    close(fd);
+
+    if((fd = open("mmapfile", O_RDONLY)) < 0)
+        fail("reopen");
+    if(read(fd, &c, 1) != 1 || c != 'X')
+        fail("shared write not in file");
+    close(fd);
+
+    // A read-only mapping can be used as a system call buffer.
+    if((fd = open("mmapfile", O_RDONLY)) < 0)
+        fail("reopen");
+    q = mmap(0, PGSIZE, PROT_READ, MAP_PRIVATE, fd, 2*PGSIZE);
+    if(q == MAP_FAILED)
+        fail("offset mmap");
+    if(q[0] != 'Z' || q[1] != 'c')
+        fail("offset contents");
+    if(pipe(pfd) < 0 || write(pfd[1], q, 2) != 2 ||
+       read(pfd[0], &c, 1) != 1 || c != 'Z')
+        fail("write from mapping");
+
+    // But the kernel may not write to it for us.
+    if(write(pfd[1], "ab", 2) != 2)
+        fail("pipe write");
+    if(read(pfd[0], q, 2) != -1)
+        fail("pipe read into read-only mapping");
+    if(read(fd, q, 1) != -1)
+        fail("file read into read-only mapping");
+    if(q[0] != 'Z')
+        fail("read-only mapping changed");
+    close(pfd[0]);
+    close(pfd[1]);
+    munmap(q, PGSIZE);
+    close(fd);
+
+    // Touching an unmapped page kills the process.
+    if(fork() == 0)
+    {
+        q[0] = 1;
+        fail("unmapped page still there");
+    }
+    wait();
+
+    unlink("mmapfile");
+    printf(1, "mmaptest ok\n");
+    exit();
+}
@@ -0,0 +1,124 @@
+// a user program for testing demand-paged exec: copies of one
+// program share the pages of its file, so each copy costs only
+// its stack, page tables and the pages it writes, and the file
+// can't be written while it runs
+// usage: pagetest
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NCOPY   8
+#define PGSIZE  4096
+
+// Big enough to span several pages of the program file. Not
+// static, or the compiler folds the copies' reads of it away.
+char table[8*PGSIZE] = { 1 };
+
+static void
+fail(char *what)
+{
+    printf(2, "pagetest: %s\n", what);
+    exit();
+}
+
+int
+main(int argc, char *argv[])
+{
+    int i, fd, up[2], down[2], before, base, used, sum, npages;
+    char *args[3];
+    char c;
+
+    if(argc > 1)
+    {
+        // A copy: read all of table, then wait for the parent.
+        sum = 0;
+        for(i = 0; i < sizeof(table); i += PGSIZE)
+            sum += table[i];
+        if(sum != 1)
+            printf(2, "pagetest: copy read %d from table\n", sum);
+        write(1, "x", 1);
+        read(0, &c, 1);
+        exit();
+    }
+
+    if(pipe(up) < 0 || pipe(down) < 0)
+    {
+        printf(2, "pagetest: pipe failed\n");
+        exit();
+    }
+    // The program's pages, less the stack and its guard page.
+    npages = (uint)sbrk(0) / PGSIZE - 2;
+
+    // What NCOPY processes cost without pages of the program of
+    // their own: page tables, kernel stacks, a stack page each.
+    // Forked children share ours copy-on-write.
+    before = freepages();
+    for(i = 0; i < NCOPY; i++)
+    {
+        if(fork() == 0)
+        {
+            write(up[1], "x", 1);
+            read(down[0], &c, 1);
+            exit();
+        }
+    }
+    for(i = 0; i < NCOPY; i++)
+        read(up[0], &c, 1);
+    base = before - freepages();
+    for(i = 0; i < NCOPY; i++)
+        write(down[1], "x", 1);
+    for(i = 0; i < NCOPY; i++)
+        wait();
+
+    before = freepages();
+    for(i = 0; i < NCOPY; i++)
+    {
+        if(fork() == 0)
+        {
+            // stdout goes to the parent, stdin waits for it.
+            close(0);
+            dup(down[0]);
+            close(1);
+            dup(up[1]);
+            close(up[0]);
+            close(up[1]);
+            close(down[0]);
+            close(down[1]);
+            args[0] = "pagetest";
+            args[1] = "copy";
+            args[2] = 0;
+            exec("pagetest", args);
+            printf(2, "pagetest: exec failed\n");
+            exit();
+        }
+    }
+    for(i = 0; i < NCOPY; i++)
+        read(up[0], &c, 1);
+    used = before - freepages();
+    printf(1, "%d copies of %d pages use %d pages, %d each\n",
+           NCOPY, npages, used, used / NCOPY);
+    // Past what forked children cost, the copies should need the
+    // program's pages about once, not once each.
+    if(used - base >= NCOPY/2 * npages)
+        fail("copies don't share the program's pages");
+
+    // We run pagetest too, so its file is busy. Writing back the
+    // byte that is there leaves it intact if that goes wrong.
+    if((fd = open("pagetest", O_RDONLY)) < 0 || read(fd, &c, 1) != 1)
+        fail("read own file");
+    close(fd);
+    if((fd = open("pagetest", O_WRONLY)) < 0)
+        fail("open own file");
+    if(write(fd, &c, 1) >= 0)
+        fail("wrote a running program's file");
+    close(fd);
+
+    for(i = 0; i < NCOPY; i++)
+        write(down[1], "x", 1);
+    for(i = 0; i < NCOPY; i++)
+        wait();
+    printf(1, "pagetest ok\n");
+    exit();
+}
@@ -1,4 +1,4 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC       512  // maximum number of processes
 #define KSTACKSIZE 4096  // size of per-process kernel stack
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
@@ -7,8 +7,15 @@
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
+#define NEXECSEG     4   // program segments exec loads on demand
+#define NSHM         16  // shared memory segments per system
+#define SHMMAXPG     64  // pages per shared memory segment
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define FSSIZE       2000  // size of file system in blocks
+#define NSCHED       10  // scheduling classes are numbered 1..NSCHED-1
+#define NLATBUCKET   32  // buckets of log2 scheduling latency histograms
+#define MAXORDER     10  // largest block kallocorder() gives: 2^MAXORDER pages
+#define KJUNK        1   // fill freed pages with junk; 0 saves the memset
 
@@ -0,0 +1,52 @@
+// a user program for measuring how long the scheduler takes to
+// pick the next process as the number of runnable processes grows
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define MAXSPIN 60
+#define PERIOD 200   // ticks to measure each load for
+
+int
+main(int argc, char *argv[])
+{
+    static int loads[] = {1, 4, 16, 32, 48, MAXSPIN};
+    int pids[MAXSPIN];
+    cpu_info cpu_infos[NCPU];
+    uint picks, cycles;
+    int i, j, k, n, ncpu;
+
+    for(i = 0; i < sizeof(loads)/sizeof(loads[0]); i++)
+    {
+        for(n = 0; n < loads[i]; n++)
+        {
+            pids[n] = fork();
+            if(pids[n] < 0)
+                break;
+            if(pids[n] == 0)
+                for(;;)
+                    ;   // stay runnable
+        }
+
+        cpustat(cpu_infos, NCPU, 1);
+        sleep(PERIOD);
+        ncpu = cpustat(cpu_infos, NCPU, 0);
+
+        for(k = 0; k < n; k++)
+            kill(pids[k]);
+        for(k = 0; k < n; k++)
+            wait();
+
+        picks = cycles = 0;
+        for(j = 0; j < ncpu; j++)
+        {
+            picks += cpu_infos[j].picks;
+            cycles += cpu_infos[j].pickcycles;
+        }
+        printf(1, "%d runnable: %d picks, %d cycles/pick\n",
+               n, picks, picks ? cycles / picks : 0);
+    }
+    exit();
+}
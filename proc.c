@@ -4,40 +4,99 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "x86.h"
+#include "traps.h"
 #include "proc.h"
 #include "spinlock.h"
 #include "scheduler.h"
 
+// The process table grows on demand: struct procs are carved out
+// of kalloc'd pages, up to NPROC of them, and are never freed.
+// Each stays on the all list for good, and on the free list while
+// it is UNUSED. A proc keeps its kernel stack when it is reaped,
+// so the next process to use it does not need to allocate one.
+//
+// Sleeping processes wait on a hash table of channels, so that
+// wakeup only looks at processes that hashed to the same bucket
+// rather than at the whole table.
+#define NSLEEPQ 64   // power of two
+// Every process that is not UNUSED is on the pid hash chain for
+// its pid, so kill() and friends find it without a scan.
+#define NPIDHASH 64  // power of two
+
 struct {
   struct spinlock lock;
-  struct proc proc[NPROC];
-  int priorityChanged[NCPU];      // 0 means false, 1 means ture. we should inform every cpu that priorities have changed.
-  int queue[3];
+  struct proc *all;              // linked through p->allnext
+  struct proc **alltail;
+  struct proc *free;             // linked through p->freenext
+  int nproc;                     // struct procs allocated so far
+  struct proc *sleepq[NSLEEPQ];  // linked through p->sleepnext
+  struct proc *pidhash[NPIDHASH];  // linked through p->pidnext
 } ptable;
 
+// Per-CPU run queue. Every RUNNABLE process sits on exactly one
+// run queue, in the FIFO list for its priority, linked through
+// p->rqnext and p->rqprev. A bit in bitmap is set for each
+// non-empty list, so finding the highest priority takes a bsf
+// per 32 priorities rather than a scan of the queue.
+// A cpu's scheduler holds its rq lock across the swtch into and
+// out of a process, so anyone who reaches a process through its
+// run queue, or through p->cpu, sees it fully switched out.
+// Lock order: ptable.lock before any rq lock, and never two rq
+// locks at once.
+struct runq {
+  struct spinlock lock;
+  uint bitmap[(NPRIO+31)/32];
+  struct {
+    struct proc *head;
+    struct proc *tail;
+  } queue[NPRIO];
+  struct proc *vroot;       // CFS_SCHEDULER tree, ordered by vruntime
+  unsigned long long minvruntime;
+  uint epoch;               // MLFQ_SCHEDULER: last boost period seen
+  uint tickets;             // LOTTERY_SCHEDULER: total on the queue
+  uint seed;                // LOTTERY_SCHEDULER: random state
+  int nrunnable;
+  int nthrottled;           // EDF_SCHEDULER: queued but out of runtime
+                            // when pick() last looked
+  uint nqueued;             // processes ever queued, for idle()
+  struct schedclass *sc;    // Policy that orders this queue
+};
+
+static struct runq runqs[NCPU];
+
+// Does rq have a process its cpu could run now? Only a hint
+// without rq->lock.
+static int
+rqready(struct runq *rq)
+{
+  return rq->nrunnable - rq->nthrottled > 0;
+}
+
 static struct proc *initproc;
 
+// EDF_SCHEDULER utilization reserved by setdeadline(), in
+// thousandths of a cpu. Protected by ptable.lock.
+static int dlutil;
+
 int nextpid = 1;
 extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static int edfutil(struct proc*);
 
 void
 pinit(void)
 {
+  int i;
+
   initlock(&ptable.lock, "ptable");
-  // ncpu has a correct value when we enter the scheduler(for each cpu)
-  acquire(&ptable.lock);
-  for(int i = 0; i < NCPU; i++)
-  {
-    ptable.priorityChanged[i] = 0;
-  }
-  for (int i = 0; i < 3; i++)
-  {
-    ptable.queue[i] = 0;
+  ptable.alltail = &ptable.all;
+  for(i = 0; i < NCPU; i++){
+    initlock(&runqs[i].lock, "runq");
+    runqs[i].sc = &schedclasses[SCHEDULER];
+    cpus[i].rq = &runqs[i];
   }
-  release(&ptable.lock);
 }
 
 // Must be called with interrupts disabled
@@ -79,9 +138,404 @@ myproc(void) {
   return p;
 }
 
+//PAGEBREAK: 30
+// Run queue helpers. rqappend and rqremove must be called
+// with rq->lock held.
+
+// Append p to the tail of the list for its priority.
+static void
+rqappend(struct runq *rq, struct proc *p)
+{
+  int pr = p->priority;
+
+  p->rqnext = 0;
+  p->rqprev = rq->queue[pr].tail;
+  if(rq->queue[pr].tail)
+    rq->queue[pr].tail->rqnext = p;
+  else
+    rq->queue[pr].head = p;
+  rq->queue[pr].tail = p;
+  rq->bitmap[pr/32] |= 1 << (pr%32);
+  p->onrq = 1;
+  rq->nrunnable++;
+  rq->nqueued++;
+}
+
+// Unlink p from rq.
+static void
+rqremove(struct runq *rq, struct proc *p)
+{
+  int pr = p->priority;
+
+  if(p->rqprev)
+    p->rqprev->rqnext = p->rqnext;
+  else
+    rq->queue[pr].head = p->rqnext;
+  if(p->rqnext)
+    p->rqnext->rqprev = p->rqprev;
+  else
+    rq->queue[pr].tail = p->rqprev;
+  if(rq->queue[pr].head == 0)
+    rq->bitmap[pr/32] &= ~(1 << (pr%32));
+  p->rqnext = 0;
+  p->rqprev = 0;
+  p->onrq = 0;
+  rq->nrunnable--;
+}
+
+// Return the highest (numerically lowest) priority that has
+// a runnable process on rq, or -1 if rq is empty.
+static int
+rqfirst(struct runq *rq)
+{
+  int i;
+
+  for(i = 0; i < NELEM(rq->bitmap); i++)
+    if(rq->bitmap[i])
+      return i*32 + __builtin_ctz(rq->bitmap[i]);
+  return -1;
+}
+
+// Lock the run queue of the cpu we are running on.
+// Interrupts stay off while the lock is held, so we
+// cannot be moved to another cpu in between.
+static struct runq*
+lockmyrq(void)
+{
+  struct runq *rq;
+
+  pushcli();
+  rq = mycpu()->rq;
+  acquire(&rq->lock);
+  popcli();
+  return rq;
+}
+
+// Release the run queue lock that a scheduler handed us
+// when it switched to us. That may not be the cpu we last
+// switched out on, since idle cpus steal runnable processes.
+static void
+unlockmyrq(void)
+{
+  release(&mycpu()->rq->lock);
+}
+
+// Lock and return the run queue that owns p, the one named by
+// p->cpu. A cpu that steals p changes p->cpu while holding the
+// lock of the queue it took p from, so check again once we hold it.
+// p's priority and run queue links only change under this lock.
+static struct runq*
+lockprocrq(struct proc *p)
+{
+  struct runq *rq;
+
+  for(;;){
+    rq = &runqs[p->cpu];
+    acquire(&rq->lock);
+    if(rq == &runqs[p->cpu])
+      return rq;
+    release(&rq->lock);
+  }
+}
+
+// Charge the TSC cycles since p's last state change to *acct,
+// and return them. Called when p changes state, by the cpu that
+// changes it.
+static unsigned long long
+account(struct proc *p, unsigned long long *acct)
+{
+  unsigned long long now, d;
+
+  // The TSCs of different cpus may disagree a little.
+  now = rdtsc();
+  d = now > p->tsc ? now - p->tsc : 0;
+  *acct += d;
+  p->tsc = now;
+  return d;
+}
+
+// The lathist bucket for a wait of cycles: floor(log2(cycles)).
+static int
+latbucket(unsigned long long cycles)
+{
+  if(cycles >> 32)
+    return NLATBUCKET - 1;
+  if((uint)cycles == 0)
+    return 0;
+  return 31 - __builtin_clz((uint)cycles);
+}
+
+// May p run on cpu?
+static int
+canrun(struct proc *p, int cpu)
+{
+  return (p->affinity >> cpu) & 1;
+}
+
+// The cpu to move p to when it may not stay where it is:
+// the allowed one with the fewest runnable processes.
+// setaffinity() makes sure there is one.
+static int
+allowedcpu(struct proc *p)
+{
+  int i, best;
+
+  best = -1;
+  for(i = 0; i < ncpu; i++)
+    if(canrun(p, i) &&
+       (best < 0 || runqs[i].nrunnable < runqs[best].nrunnable))
+      best = i;
+  return best;
+}
+
+// A process's vruntime only means something next to its run
+// queue's minvruntime, and the minimums of different cpus drift
+// apart. When p leaves rq for another cpu, vdetach() makes its
+// vruntime relative to rq's minimum, and vattach() rebases it on
+// the minimum of the run queue it joins, so that p keeps its
+// place: neither starved behind nor far ahead of the processes
+// there. Unsigned wraparound keeps a p behind the minimum exact.
+// Called with rq->lock held.
+static void
+vdetach(struct runq *rq, struct proc *p)
+{
+  p->vruntime -= rq->minvruntime;
+}
+
+static void
+vattach(struct runq *rq, struct proc *p)
+{
+  p->vruntime += rq->minvruntime;
+}
+
+// p has just been queued on rq. If rq's cpu is halted in idle(),
+// wake it up; otherwise wake some other idle cpu that p may run
+// on, which will steal it. Returns 1 if a cpu was woken, 0 if
+// none was idle. Called with rq->lock held.
+static int
+kickidle(struct runq *rq, struct proc *p)
+{
+  struct cpu *c;
+
+  c = &cpus[rq - runqs];
+  if(c->idle && xchg(&c->idle, 0)){
+    lapicipi(c->apicid, T_IRQ0 + IRQ_WAKEUP);
+    return 1;
+  }
+  for(c = cpus; c < cpus+ncpu; c++){
+    if(c->idle && canrun(p, c - cpus) && xchg(&c->idle, 0)){
+      lapicipi(c->apicid, T_IRQ0 + IRQ_WAKEUP);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// p has just been queued on rq, or has changed priority there.
+// If rq's cpu is running a process that p should preempt, send it
+// a reschedule IPI, so p runs now rather than at the next timer
+// tick. Otherwise look for another cpu running such a process; if
+// there is one, take p off rq and return that cpu's number, and
+// the caller must pass p to migrate() once it has released
+// rq->lock. Returns -1 if p does not need to move.
+// Called with rq->lock held.
+static int
+preempt(struct runq *rq, struct proc *p)
+{
+  struct cpu *c;
+  struct proc *q;
+
+  if(rq->sc->preempts == 0)
+    return -1;
+  c = &cpus[rq - runqs];
+  if((q = c->proc) != 0 && rq->sc->preempts(p, q)){
+    lapicipi(c->apicid, T_IRQ0 + IRQ_RESCHED);
+    return -1;
+  }
+  for(c = cpus; c < cpus+ncpu; c++){
+    // Without c's rq lock, c->proc is only a hint. If it is
+    // stale, c just finds nothing better than p to run.
+    if(c->rq == rq || (q = c->proc) == 0 || !canrun(p, c - cpus))
+      continue;
+    if(rq->sc->preempts(p, q)){
+      rq->sc->dequeue(rq, p);
+      vdetach(rq, p);
+      p->cpu = c - cpus;
+      return p->cpu;
+    }
+  }
+  return -1;
+}
+
+// Queue p, which preempt() or the scheduler took off its old run
+// queue, on cpu's run queue and make cpu reschedule.
+static void
+migrate(struct proc *p, int cpu)
+{
+  struct runq *rq = &runqs[cpu];
+
+  acquire(&rq->lock);
+  vattach(rq, p);
+  rq->sc->enqueue(rq, p);
+  lapicipi(cpus[cpu].apicid, T_IRQ0 + IRQ_RESCHED);
+  release(&rq->lock);
+}
+
+// Mark p RUNNABLE and queue it on the cpu it last ran on, whose
+// cache is most likely to still hold its working set, unless its
+// affinity no longer allows that cpu.
+// Caller must hold ptable.lock. If p is still switching out
+// on that cpu, this waits until the switch has finished.
+static void
+makerunnable(struct proc *p)
+{
+  struct runq *rq = lockprocrq(p);
+  int cpu = -1;
+
+  if(!canrun(p, p->cpu)){
+    // Nobody else moves p while it is off every run queue.
+    vdetach(rq, p);
+    release(&rq->lock);
+    p->cpu = allowedcpu(p);
+    rq = lockprocrq(p);
+    vattach(rq, p);
+  }
+
+  if(p->state == SLEEPING)
+    account(p, &p->sleepcycles);
+  else
+    p->tsc = rdtsc();     // new from fork
+  p->state = RUNNABLE;
+  rq->sc->enqueue(rq, p);
+  if(!kickidle(rq, p))
+    cpu = preempt(rq, p);
+  release(&rq->lock);
+  if(cpu >= 0)
+    migrate(p, cpu);
+}
+
+// Change p's priority. If p is waiting on a run queue, requeue
+// it so that its class sees the new priority, and preempt a
+// running process that now ranks below it.
+// Caller must hold ptable.lock.
+static void
+setpriority(struct proc *p, int priority)
+{
+  struct runq *rq = lockprocrq(p);
+  int cpu = -1;
+
+  if(p->onrq){
+    rq->sc->dequeue(rq, p);
+    p->priority = priority;
+    rq->sc->enqueue(rq, p);
+    cpu = preempt(rq, p);
+  } else
+    p->priority = priority;
+  release(&rq->lock);
+  if(cpu >= 0)
+    migrate(p, cpu);
+}
+
+// Wait until p, which has just stopped for good, has finished
+// switching out, so that its kernel stack can be freed.
+static void
+rqsync(struct proc *p)
+{
+  release(&lockprocrq(p)->lock);
+}
+
+// Process lookup helpers. Caller must hold ptable.lock.
+
+// The process with pid, or 0.
+static struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  for(p = ptable.pidhash[pid & (NPIDHASH-1)]; p; p = p->pidnext)
+    if(p->pid == pid)
+      return p;
+  return 0;
+}
+
+static void
+pidunhash(struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &ptable.pidhash[p->pid & (NPIDHASH-1)]; *pp; pp = &(*pp)->pidnext)
+    if(*pp == p){
+      *pp = p->pidnext;
+      break;
+    }
+  p->pidnext = 0;
+}
+
+// Make p a child of parent. A process's children are linked
+// through nextsib and prevsib, so that wait() and exit() only
+// look at them, and a child is unlinked in O(1).
+static void
+addchild(struct proc *parent, struct proc *p)
+{
+  p->parent = parent;
+  p->prevsib = 0;
+  p->nextsib = parent->child;
+  if(parent->child)
+    parent->child->prevsib = p;
+  parent->child = p;
+}
+
+static void
+delchild(struct proc *p)
+{
+  if(p->prevsib)
+    p->prevsib->nextsib = p->nextsib;
+  else
+    p->parent->child = p->nextsib;
+  if(p->nextsib)
+    p->nextsib->prevsib = p->prevsib;
+  p->nextsib = 0;
+  p->prevsib = 0;
+  p->parent = 0;
+}
+
+// Grow the process table by a page of UNUSED procs.
+// Returns 0 if the table is full or memory is short.
+// Caller must hold ptable.lock.
+static int
+growptable(void)
+{
+  struct proc *p, *end;
+  char *mem;
+
+  if(ptable.nproc + PGSIZE/sizeof(struct proc) > NPROC)
+    return 0;
+  if((mem = kzalloc()) == 0)
+    return 0;
+  end = (struct proc*)mem + PGSIZE/sizeof(struct proc);
+  for(p = (struct proc*)mem; p < end; p++){
+    *ptable.alltail = p;
+    ptable.alltail = &p->allnext;
+    p->freenext = ptable.free;
+    ptable.free = p;
+    ptable.nproc++;
+  }
+  return 1;
+}
+
+// Put p, which has just become UNUSED, back on the free list.
+// Caller must hold ptable.lock.
+static void
+freeproc(struct proc *p)
+{
+  p->state = UNUSED;
+  p->freenext = ptable.free;
+  ptable.free = p;
+}
+
 //PAGEBREAK: 32
-// Look in the process table for an UNUSED proc.
-// If found, change state to EMBRYO and initialize
+// Take an UNUSED proc from the process table, growing it if
+// there is none. If found, change state to EMBRYO and initialize
 // state required to run in the kernel.
 // Otherwise return 0.
 static struct proc*
@@ -92,52 +546,51 @@ allocproc(void)
 
   acquire(&ptable.lock);
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
-
-  release(&ptable.lock);
-  return 0;
+  if(ptable.free == 0 && !growptable()){
+    release(&ptable.lock);
+    return 0;
+  }
+  p = ptable.free;
+  ptable.free = p->freenext;
 
-found:
   p->state = EMBRYO;
   p->pid = nextpid++;
+  p->pidnext = ptable.pidhash[p->pid & (NPIDHASH-1)];
+  ptable.pidhash[p->pid & (NPIDHASH-1)] = p;
+  p->parent = 0;
+  p->child = 0;
 
   p->stime = ticks;       // set start time
   p->etime = 0;           // set end time to 0, means it’s not valid
   p->rtime = 0;           // set run time to 0
   p->iotime = 0;          // set i/o time to 0
-
-  switch (SCHEDULER)
-  {
-    case MAIN_SCHEDULER:
-      p->priority = 0;
-      break;
-
-    case TEST_SCHEDULER:
-      p->priority = 10;
-      break;
-
-    case PRIORITY_SCHEDULER:
-      p->priority = 60;
-      break;
-
-    case MLQ_SCHEDULER:
-      // in this scheduler, priority shows the number of the queue.
-      // 1(highest priority) -> 2(medium priority) -> 3(lowest priority)
-      p->priority = 1;
-      ptable.queue[0]++;
-      break;
-
-    default:
-      break;
-  }
+  p->runcycles = 0;
+  p->waitcycles = 0;
+  p->sleepcycles = 0;
+  p->vruntime = 0;
+  p->slice = 0;
+  p->tickets = DEFTICKETS;
+  p->affinity = ~0;       // any cpu
+  p->dlruntime = 0;       // not a deadline process
+  p->dlperiod = 0;
+  p->dldeadline = 0;
+  p->dlmisses = 0;
+  p->execip = 0;
+  p->nseg = 0;
+  p->vmas = 0;
+
+  // the scheduling class decides where new processes start.
+  // in MLQ_SCHEDULER, priority shows the number of the queue.
+  p->priority = schedclasses[curscheduler].initprio;
 
   release(&ptable.lock);
 
-  // Allocate kernel stack.
-  if((p->kstack = kalloc()) == 0){
-    p->state = UNUSED;
+  // Allocate kernel stack, unless p kept its last one.
+  if(p->kstack == 0 && (p->kstack = kalloc()) == 0){
+    acquire(&ptable.lock);
+    pidunhash(p);
+    freeproc(p);
+    release(&ptable.lock);
     return 0;
   }
   sp = p->kstack + KSTACKSIZE;
@@ -190,9 +643,13 @@ userinit(void)
   // run this process. the acquire forces the above
   // writes to be visible, and the lock is also needed
   // because the assignment might not be atomic.
+  pushcli();
+  p->cpu = cpuid();
+  popcli();
+
   acquire(&ptable.lock);
 
-  p->state = RUNNABLE;
+  makerunnable(p);
 
   release(&ptable.lock);
 }
@@ -207,8 +664,10 @@ growproc(int n)
 
   sz = curproc->sz;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    // Pages are allocated when first touched; see zerofault.
+    if(sz + n < sz || sz + n > mmapbase(curproc))
       return -1;
+    sz += n;
   } else if(n < 0){
     if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
@@ -235,13 +694,26 @@ fork(void)
 
   // Copy process state from proc.
   if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
-    kfree(np->kstack);
-    np->kstack = 0;
-    np->state = UNUSED;
+    acquire(&ptable.lock);
+    pidunhash(np);
+    freeproc(np);
+    release(&ptable.lock);
+    return -1;
+  }
+  if(mmapfork(np) < 0){
+    munmapall(np);
+    freevm(np->pgdir);
+    np->pgdir = 0;
+    acquire(&ptable.lock);
+    pidunhash(np);
+    freeproc(np);
+    release(&ptable.lock);
     return -1;
   }
   np->sz = curproc->sz;
-  np->parent = curproc;
+  np->vruntime = curproc->vruntime;
+  np->tickets = curproc->tickets;
+  np->affinity = curproc->affinity;
   *np->tf = *curproc->tf;
 
   // Clear %eax so that fork returns 0 in the child.
@@ -251,14 +723,24 @@ fork(void)
     if(curproc->ofile[i])
       np->ofile[i] = filedup(curproc->ofile[i]);
   np->cwd = idup(curproc->cwd);
+  if(curproc->execip){
+    np->execip = idup(curproc->execip);
+    ideny(np->execip);
+  }
+  np->nseg = curproc->nseg;
+  memmove(np->seg, curproc->seg, sizeof(np->seg));
 
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
 
   pid = np->pid;
 
+  // Start the child on our cpu; idle cpus will steal it.
+  np->cpu = curproc->cpu;
+
   acquire(&ptable.lock);
 
-  np->state = RUNNABLE;
+  addchild(curproc, np);
+  makerunnable(np);
 
   release(&ptable.lock);
 
@@ -278,6 +760,9 @@ exit(void)
   if(curproc == initproc)
     panic("init exiting");
 
+  // Write back and drop mapped regions.
+  munmapall(curproc);
+
   // Close all open files.
   for(fd = 0; fd < NOFILE; fd++){
     if(curproc->ofile[fd]){
@@ -286,10 +771,15 @@ exit(void)
     }
   }
 
+  if(curproc->execip)
+    iallow(curproc->execip);
   begin_op();
   iput(curproc->cwd);
+  if(curproc->execip)
+    iput(curproc->execip);
   end_op();
   curproc->cwd = 0;
+  curproc->execip = 0;
 
   acquire(&ptable.lock);
 
@@ -297,18 +787,26 @@ exit(void)
   wakeup1(curproc->parent);
 
   // Pass abandoned children to init.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->parent == curproc){
-      p->parent = initproc;
-      if(p->state == ZOMBIE)
-        wakeup1(initproc);
-    }
+  while((p = curproc->child) != 0){
+    delchild(p);
+    addchild(initproc, p);
+    if(p->state == ZOMBIE)
+      wakeup1(initproc);
   }
 
   curproc->etime = ticks;   // set exit time when process terminates
 
+  // Give back our EDF_SCHEDULER reservation; dlmisses stays
+  // for waitdl().
+  dlutil -= edfutil(curproc);
+  curproc->dlperiod = 0;
+
   // Jump into the scheduler, never to return.
+  // Hold our run queue lock until the switch is done so that
+  // wait() cannot free our stack under us (see rqsync).
   curproc->state = ZOMBIE;
+  lockmyrq();
+  release(&ptable.lock);
   sched();
   panic("zombie exit");
 }
@@ -317,365 +815,821 @@ exit(void)
 // Return -1 if this process has no children.
 int
 wait(void)
+{
+  return kwaitx(0, 0, 0, 0);
+}
+
+//PAGEBREAK: 42
+// Scheduling policies. Each pick function chooses the next
+// process to run from a run queue, unlinks it and returns it,
+// or returns 0 if the queue is empty. Called with rq->lock held.
+// See struct schedclass in scheduler.h.
+
+// A cpu with nothing of its own to run steals from another cpu's
+// queue, passing its number to pick(). Only processes whose
+// affinity allows that cpu count, and the rest stay where they
+// are, so the thief goes idle rather than spinning on processes
+// it may not take. A cpu picking from its own queue passes -1.
+static int
+mayrun(struct proc *p, int cpu)
+{
+  return cpu < 0 || canrun(p, cpu);
+}
+
+// The first process that may run on cpu, in priority order
+// and then FIFO order, or 0.
+static struct proc*
+rqfirstfor(struct runq *rq, int cpu)
 {
   struct proc *p;
-  int havekids, pid;
-  struct proc *curproc = myproc();
-  
-  acquire(&ptable.lock);
-  for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
+  int pr;
+
+  if((pr = rqfirst(rq)) < 0)
+    return 0;
+  if(cpu < 0)
+    return rq->queue[pr].head;
+  for(; pr < NPRIO; pr++)
+    for(p = rq->queue[pr].head; p; p = p->rqnext)
+      if(canrun(p, cpu))
+        return p;
+  return 0;
+}
+
+// MAIN_SCHEDULER and PRIORITY_SCHEDULER: the head of the list
+// for the highest priority. Each list is FIFO, which gives round
+// robin for the processes that have same priority (and for all of
+// them under MAIN_SCHEDULER, where every priority is 0).
+static struct proc*
+pickfirst(struct runq *rq, int cpu)
+{
+  struct proc *p;
+
+  if((p = rqfirstfor(rq, cpu)) != 0)
+    rqremove(rq, p);
+  return p;
+}
+
+// MLQ_SCHEDULER: priority is the number of the queue,
+// 1(highest priority) -> 2(medium priority) -> 3(lowest priority).
+// Queue 1 uses guaranteed scheduling: the process with the lowest
+// rtime relative to the time it is entitled to (ticks since it
+// started / processes in queue 1) goes first. The queue length is
+// the same for everyone, so it cancels out of the comparison.
+// Queue 2 is FIFO by start time and queue 3 is round robin.
+static struct proc*
+pickmlq(struct runq *rq, int cpu)
+{
+  struct proc *p, *best;
+  int pr;
+
+  if((pr = rqfirst(rq)) < 0)
+    return 0;
+  for(; pr < NPRIO; pr++){
+    best = 0;
+    for(p = rq->queue[pr].head; p; p = p->rqnext){
+      if(!mayrun(p, cpu))
         continue;
-      havekids = 1;
-      if(p->state == ZOMBIE){
-        // Found one.
-        pid = p->pid;
-        kfree(p->kstack);
-        p->kstack = 0;
-        freevm(p->pgdir);
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
-        release(&ptable.lock);
-        return pid;
-      }
+      if(best == 0)
+        best = p;
+      else if(pr == 1 &&
+         (unsigned long long)p->rtime * (ticks - best->stime) <
+         (unsigned long long)best->rtime * (ticks - p->stime))
+        best = p;
+      else if(pr == 2 && p->stime < best->stime)
+        best = p;
     }
-
-    // No point waiting if we don't have any children.
-    if(!havekids || curproc->killed){
-      release(&ptable.lock);
-      return -1;
+    if(best){
+      rqremove(rq, best);
+      return best;
     }
+  }
+  return 0;
+}
 
-    // Wait for children to exit.  (See wakeup1 call in proc_exit.)
-    sleep(curproc, &ptable.lock);  //DOC: wait-sleep
+// MLQ_SCHEDULER: after each run a process drops to the next queue.
+// Called with this cpu's rq lock held; a process that yielded is
+// already back on that run queue.
+static void
+mlqran(struct proc *p, uint cycles)
+{
+  struct runq *rq = &runqs[p->cpu];
+
+  if(p->state == ZOMBIE || p->priority >= 3)
+    return;
+  if(p->onrq){
+    rqremove(rq, p);
+    p->priority++;
+    rqappend(rq, p);
+  } else
+    p->priority++;
+}
+
+// PRIORITY_SCHEDULER and MLQ_SCHEDULER: a process preempts one
+// with a lower priority (a higher value, or a later queue).
+static int
+prioritypreempts(struct proc *p, struct proc *q)
+{
+  return p->priority < q->priority;
+}
+
+//PAGEBREAK: 40
+// MLFQ_SCHEDULER: multi-level feedback queue. priority is the
+// level, 0 (highest) .. MLFQ_LEVELS-1. A process starts at level
+// 0 and drops a level each time it has used up that level's
+// quantum; the ticks it used before sleeping count towards it,
+// so it cannot stay on top by sleeping just before the quantum
+// ends. Processes that block for I/O therefore stay at the top
+// and preempt the cpu-bound ones below as soon as they wake.
+// Every MLFQ_BOOST ticks all processes go back to level 0, so
+// the bottom level cannot starve and a process whose behaviour
+// changed gets a new chance.
+#define MLFQ_LEVELS 4
+#define MLFQ_BOOST  100
+
+static int mlfqquantum[MLFQ_LEVELS] = { 1, 2, 4, 8 };
+
+static uint
+mlfqepoch(void)
+{
+  return ticks / MLFQ_BOOST;
+}
+
+// Put p back at level 0 if a boost happened since it got its level.
+static void
+mlfqrenew(struct proc *p)
+{
+  if(p->epoch != mlfqepoch()){
+    p->epoch = mlfqepoch();
+    p->priority = 0;
+    p->slice = 0;
   }
 }
 
-//PAGEBREAK: 42
-// Per-CPU process scheduler.
-// Each CPU calls scheduler() after setting itself up.
-// Scheduler never returns.  It loops, doing:
-//  - choose a process to run
-//  - swtch to start running that process
-//  - eventually that process transfers control
-//      via swtch back to the scheduler.
-void
-main_scheduler(void)
+static void
+mlfqenqueue(struct runq *rq, struct proc *p)
+{
+  mlfqrenew(p);
+  rqappend(rq, p);
+}
+
+// Level 0 first, round robin within a level. The first pick in
+// each boost period moves everything still queued to level 0.
+static struct proc*
+pickmlfq(struct runq *rq, int cpu)
 {
   struct proc *p;
-  struct cpu *c = mycpu();
-  c->proc = 0;
-  
-  for(;;){
-    // Enable interrupts on this processor.
-    sti();
+  int pr;
+
+  if(rq->epoch != mlfqepoch()){
+    rq->epoch = mlfqepoch();
+    for(pr = 1; pr < MLFQ_LEVELS; pr++){
+      while((p = rq->queue[pr].head) != 0){
+        rqremove(rq, p);
+        mlfqrenew(p);
+        rqappend(rq, p);
+      }
+    }
+  }
+  return pickfirst(rq, cpu);
+}
 
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
-        continue;
+// Demote p if it used up its quantum. Called with this cpu's
+// rq lock held; a process that yielded is already back on it.
+static void
+mlfqran(struct proc *p, uint cycles)
+{
+  struct runq *rq = &runqs[p->cpu];
+  int queued;
+
+  if(p->state == ZOMBIE)
+    return;
+  if((queued = p->onrq) != 0)
+    rqremove(rq, p);
+  mlfqrenew(p);
+  if(p->priority >= MLFQ_LEVELS)
+    p->priority = MLFQ_LEVELS-1;
+  if(p->slice >= mlfqquantum[p->priority]){
+    p->slice = 0;
+    if(p->priority < MLFQ_LEVELS-1)
+      p->priority++;
+  }
+  if(queued)
+    rqappend(rq, p);
+}
 
-      // Switch to chosen process.  It is the process's job
-      // to release ptable.lock and then reacquire it
-      // before jumping back to us.
-      c->proc = p;
-      switchuvm(p);
-      p->state = RUNNING;
+// Keep running until the quantum of p's level is used up.
+static int
+mlfqtick(struct proc *p)
+{
+  int pr = p->priority;
 
-      swtch(&(c->scheduler), p->context);   // resumes the for loop
-      switchkvm();
+  if(pr >= MLFQ_LEVELS)
+    return 1;
+  return ++p->slice >= mlfqquantum[pr];
+}
 
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
-      c->proc = 0;
-    }
-    release(&ptable.lock);
+//PAGEBREAK: 40
+// CFS_SCHEDULER: completely fair scheduling. Each process has a
+// virtual runtime, the TSC cycles it has run scaled down by its
+// weight, and the process with the smallest vruntime runs next.
+// The runnable processes sit in a treap: a search tree ordered by
+// vruntime that is also heap-ordered on a pseudo-random key made
+// from the pid, which keeps it balanced in expectation.
+
+// A woken process is placed at most this far (in vruntime) behind
+// the run queue's minimum, so a shell that slept for a long time
+// runs promptly but cannot then monopolize the cpu.
+#define CFS_SLEEPCREDIT  20000000
+// A woken process preempts the running one only if it is behind
+// by more than this, to limit switching between near-equal ones.
+#define CFS_WAKEUPGRAN    2000000
+
+// Weight of a priority: 1024 at priority 50, doubling every
+// 10 points towards 0, so priority 0 gets 32 times the cpu of
+// priority 50 and priority 100 gets a 32nd of it.
+static uint
+cfsweight(int priority)
+{
+  static uint frac[10] = {  // 1024 * 2^(i/10)
+    1024, 1097, 1176, 1261, 1351, 1448, 1552, 1663, 1783, 1911
+  };
+  int d, q;
 
+  d = 50 - priority;
+  q = d >= 0 ? d/10 : -((-d + 9)/10);
+  d -= q*10;
+  return q >= 0 ? frac[d] << q : frac[d] >> -q;
+}
+
+static uint
+treapkey(struct proc *p)
+{
+  return p->pid * 2654435761u;
+}
+
+// Rotate x above its parent, keeping the search order.
+static void
+treaprotate(struct runq *rq, struct proc *x)
+{
+  struct proc *p, *g;
+
+  p = x->vparent;
+  g = p->vparent;
+  if(p->vleft == x){
+    p->vleft = x->vright;
+    if(x->vright)
+      x->vright->vparent = p;
+    x->vright = p;
+  } else {
+    p->vright = x->vleft;
+    if(x->vleft)
+      x->vleft->vparent = p;
+    x->vleft = p;
   }
+  p->vparent = x;
+  x->vparent = g;
+  if(g == 0)
+    rq->vroot = x;
+  else if(g->vleft == p)
+    g->vleft = x;
+  else
+    g->vright = x;
 }
 
-// don’t use this scheduler.
-// it’s not compatibale with proc changes that we have made
-void
-test_scheduler(void)
+// Insert p into rq's tree. Equal vruntimes go right,
+// so they run in FIFO order.
+static void
+vinsert(struct runq *rq, struct proc *p)
 {
-  struct proc *p, *p1;
-  struct cpu *c = mycpu();
-  c->proc = 0;
-  
-  for(;;){
-    // Enable interrupts on this processor.
-    sti();
+  struct proc **link, *parent;
+
+  parent = 0;
+  link = &rq->vroot;
+  while(*link){
+    parent = *link;
+    if(p->vruntime < parent->vruntime)
+      link = &parent->vleft;
+    else
+      link = &parent->vright;
+  }
+  p->vleft = 0;
+  p->vright = 0;
+  p->vparent = parent;
+  *link = p;
+  while(p->vparent && treapkey(p->vparent) < treapkey(p))
+    treaprotate(rq, p);
+
+  p->onrq = 1;
+  rq->nrunnable++;
+  rq->nqueued++;
+}
 
-    struct proc *highP;
+static void
+cfsenqueue(struct runq *rq, struct proc *p)
+{
+  if(rq->minvruntime > CFS_SLEEPCREDIT &&
+     p->vruntime < rq->minvruntime - CFS_SLEEPCREDIT)
+    p->vruntime = rq->minvruntime - CFS_SLEEPCREDIT;
+  vinsert(rq, p);
+}
 
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
-        continue;
+static void
+cfsdequeue(struct runq *rq, struct proc *p)
+{
+  struct proc *c;
 
-      // Switch to chosen process.  It is the process's job
-      // to release ptable.lock and then reacquire it
-      // before jumping back to us.
-
-      highP = p;
-      //choose one with highest priority
-      for(p1 = ptable.proc; p1 < &ptable.proc[NPROC]; p1++){
-        if(p1->state != RUNNABLE)
-          continue;
-          
-        if(highP->priority > p1->priority)   //larger value, lower priority
-          highP = p1;
-      }
-      p = highP;
-      c->proc = p;
-      switchuvm(p);
-      p->state = RUNNING;
+  // Rotate p down until it has at most one child,
+  // then splice it out.
+  while(p->vleft && p->vright){
+    if(treapkey(p->vleft) > treapkey(p->vright))
+      treaprotate(rq, p->vleft);
+    else
+      treaprotate(rq, p->vright);
+  }
+  c = p->vleft ? p->vleft : p->vright;
+  if(c)
+    c->vparent = p->vparent;
+  if(p->vparent == 0)
+    rq->vroot = c;
+  else if(p->vparent->vleft == p)
+    p->vparent->vleft = c;
+  else
+    p->vparent->vright = c;
+  p->vleft = 0;
+  p->vright = 0;
+  p->vparent = 0;
+
+  p->onrq = 0;
+  rq->nrunnable--;
+}
 
-      swtch(&(c->scheduler), p->context);
-      switchkvm();
+static struct proc*
+cfsleftmost(struct runq *rq)
+{
+  struct proc *p;
 
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
-      c->proc = 0;
-    }
-    release(&ptable.lock);
+  if((p = rq->vroot) != 0)
+    while(p->vleft)
+      p = p->vleft;
+  return p;
+}
+
+// The process after p in vruntime order, or 0.
+static struct proc*
+vnext(struct proc *p)
+{
+  if(p->vright){
+    for(p = p->vright; p->vleft; p = p->vleft)
+      ;
+    return p;
+  }
+  while(p->vparent && p == p->vparent->vright)
+    p = p->vparent;
+  return p->vparent;
+}
+
+static struct proc*
+pickcfs(struct runq *rq, int cpu)
+{
+  struct proc *p;
+
+  for(p = cfsleftmost(rq); p && !mayrun(p, cpu); p = vnext(p))
+    ;
+  if(p)
+    cfsdequeue(rq, p);
+  return p;
+}
+
+// Add delta to p's vruntime, and move the run queue's minimum
+// vruntime forward. Called with this cpu's rq lock held; a
+// process that yielded is already back in the tree.
+static void
+vcharge(struct proc *p, unsigned long long delta)
+{
+  struct runq *rq = &runqs[p->cpu];
+  struct proc *first;
+  unsigned long long min;
+  int queued;
+
+  if(p->state == ZOMBIE)
+    return;
+  if((queued = p->onrq) != 0)
+    cfsdequeue(rq, p);
+  p->vruntime += delta;
+
+  min = p->vruntime;
+  if((first = cfsleftmost(rq)) != 0 && (first->vruntime < min || !queued))
+    min = first->vruntime;
+  if(min > rq->minvruntime)
+    rq->minvruntime = min;
+
+  if(queued)
+    vinsert(rq, p);
+}
+
+// Charge p for the cycles it just ran: cycles*1024/weight,
+// without 64-bit division.
+static void
+cfsran(struct proc *p, uint cycles)
+{
+  uint w = cfsweight(p->priority);
+
+  vcharge(p, (unsigned long long)(cycles/w)*1024 + (cycles%w)*1024/w);
+}
+
+// p and q may be on different cpus, whose minimums differ, so
+// compare how far each is from its own run queue's minimum, as
+// vdetach() would leave it. The other cpu's minimum is only a
+// hint without its rq lock.
+static int
+cfspreempts(struct proc *p, struct proc *q)
+{
+  long long pv, qv;
+
+  pv = p->vruntime - runqs[p->cpu].minvruntime;
+  qv = q->vruntime - runqs[q->cpu].minvruntime;
+  return pv + CFS_WAKEUPGRAN < qv;
+}
+
+//PAGEBREAK: 30
+// STRIDE_SCHEDULER: proportional share. Each process gets cpu
+// time in proportion to its tickets. Its stride is STRIDE1 /
+// tickets, and its pass (kept in vruntime, so it shares the CFS
+// tree) advances by the stride for every TSC cycle it runs; the
+// lowest pass runs next. Unlike CFS, a process that slept gets
+// no credit for it: it rejoins at the run queue's minimum pass.
+#define STRIDE1 (1 << 20)
+
+static void
+strideenqueue(struct runq *rq, struct proc *p)
+{
+  if(p->vruntime < rq->minvruntime)
+    p->vruntime = rq->minvruntime;
+  vinsert(rq, p);
+}
+
+static void
+strideran(struct proc *p, uint cycles)
+{
+  vcharge(p, (unsigned long long)cycles * (STRIDE1 / p->tickets));
+}
+
+// LOTTERY_SCHEDULER: the randomized version. Every pick draws a
+// ticket among those of the runnable processes on the run queue,
+// and the process holding it runs.
+static void
+lotteryenqueue(struct runq *rq, struct proc *p)
+{
+  rqappend(rq, p);
+  rq->tickets += p->tickets;
+}
+
+static void
+lotterydequeue(struct runq *rq, struct proc *p)
+{
+  rqremove(rq, p);
+  rq->tickets -= p->tickets;
+}
+
+static struct proc*
+picklottery(struct runq *rq, int cpu)
+{
+  struct proc *p, *last;
+  uint winner, total;
+  int pr;
+
+  if((pr = rqfirst(rq)) < 0)
+    return 0;
+  total = rq->tickets;
+  if(cpu >= 0)
+    for(total = 0, p = rq->queue[pr].head; p; p = p->rqnext)
+      if(canrun(p, cpu))
+        total += p->tickets;
+  if(total == 0)
+    return 0;
+  // xorshift32; the seed only has to be nonzero.
+  if(rq->seed == 0)
+    rq->seed = rdtsc() | 1;
+  rq->seed ^= rq->seed << 13;
+  rq->seed ^= rq->seed >> 17;
+  rq->seed ^= rq->seed << 5;
+  winner = rq->seed % total;
+
+  last = 0;
+  for(p = rq->queue[pr].head; p; p = p->rqnext){
+    if(!mayrun(p, cpu))
+      continue;
+    last = p;
+    if(winner < p->tickets)
+      break;
+    winner -= p->tickets;
+  }
+  lotterydequeue(rq, last);
+  return last;
+}
+
+//PAGEBREAK: 40
+// EDF_SCHEDULER: earliest deadline first. A process that called
+// setdeadline(runtime, period, deadline) gets up to runtime ticks
+// of cpu in every period, and each period's job should be done
+// within deadline ticks of the period's start. A job is done when
+// the process blocks. Deadline processes sit on list 0 of the run
+// queue and the one with the earliest deadline runs, without time
+// slicing, until it blocks or uses up its runtime; then it is
+// throttled until its next period. Everything else is best effort:
+// list 1, round robin, run only when no deadline process can.
+// A period starts when the previous one ended and the process
+// wants the cpu again, so one that sleeps past a period boundary
+// is not charged for the time it did not ask for.
+
+
+static int
+edfutil(struct proc *p)
+{
+  if(p->dlperiod == 0)
+    return 0;
+  return p->dlruntime * 1000 / p->dlperiod;
+}
+
+// Start p's next period if the current one is over, counting the
+// current job as missed if it never finished. Called either with
+// p's rq lock held or by p's own cpu while p runs.
+static void
+edfrelease(struct proc *p)
+{
+  if(ticks < p->dlnext)
+    return;
+  if(!p->dldone)
+    p->dlmisses++;
+  p->dlabs = ticks + p->dldeadline;
+  p->dlnext = ticks + p->dlperiod;
+  p->dlremain = p->dlruntime;
+  p->dldone = 0;
+}
+
+static void
+edfenqueue(struct runq *rq, struct proc *p)
+{
+  if(p->dlperiod){
+    edfrelease(p);
+    p->priority = 0;
+  } else
+    p->priority = 1;
+  rqappend(rq, p);
+}
 
+// The unthrottled deadline process with the earliest deadline,
+// or else the first best-effort one. The deadline list is short:
+// admission control and NPROC bound it.
+static struct proc*
+pickedf(struct runq *rq, int cpu)
+{
+  struct proc *p, *best;
+
+  best = 0;
+  rq->nthrottled = 0;
+  for(p = rq->queue[0].head; p; p = p->rqnext){
+    edfrelease(p);
+    if(p->dlremain <= 0)
+      rq->nthrottled++;
+    else if(mayrun(p, cpu) && (best == 0 || p->dlabs < best->dlabs))
+      best = p;
   }
+  for(p = rq->queue[1].head; best == 0 && p; p = p->rqnext)
+    if(mayrun(p, cpu))
+      best = p;
+  if(best)
+    rqremove(rq, best);
+  return best;
 }
 
-void
-priority_scheduler(void)
+// A deadline process that blocked has finished its job.
+static void
+edfran(struct proc *p, uint cycles)
 {
-  struct proc *p;  
-  struct cpu *c = mycpu();
-  c->proc = 0;
+  if(p->dlperiod == 0 || p->state != SLEEPING || p->dldone)
+    return;
+  if(ticks > p->dlabs)
+    p->dlmisses++;
+  p->dldone = 1;
+}
 
-  int highestPriority;
+static int
+edfpreempts(struct proc *p, struct proc *q)
+{
+  return p->dlperiod && p->dlremain > 0 &&
+         (q->dlperiod == 0 || p->dlabs < q->dlabs);
+}
 
-  for(;;)
-  {
-    // Enable interrupts on this processor.
-    sti();
+// Charge a deadline process for the tick; it yields only once
+// its runtime is used up. Best-effort processes yield every tick.
+static int
+edftick(struct proc *p)
+{
+  if(p->dlperiod == 0)
+    return 1;
+  edfrelease(p);
+  return --p->dlremain <= 0;
+}
+
+// The scheduling classes, indexed by scheduler number.
+struct schedclass schedclasses[NSCHED] = {
+[MAIN_SCHEDULER]     { "MAIN_SCHEDULER",      0,  -1, rqappend, rqremove,
+                       pickfirst, 0, 0 },
+[TEST_SCHEDULER]     { "TEST_SCHEDULER",     10,  20, rqappend, rqremove,
+                       pickfirst, 0, prioritypreempts },
+[PRIORITY_SCHEDULER] { "PRIORITY_SCHEDULER", 60, 100, rqappend, rqremove,
+                       pickfirst, 0, prioritypreempts },
+[MLQ_SCHEDULER]      { "MLQ_SCHEDULER",       1,  -1, rqappend, rqremove,
+                       pickmlq, mlqran, prioritypreempts },
+[CFS_SCHEDULER]      { "CFS_SCHEDULER",      50, 100, cfsenqueue, cfsdequeue,
+                       pickcfs, cfsran, cfspreempts },
+[MLFQ_SCHEDULER]     { "MLFQ_SCHEDULER",      0,  -1, mlfqenqueue, rqremove,
+                       pickmlfq, mlfqran, prioritypreempts, mlfqtick },
+[STRIDE_SCHEDULER]   { "STRIDE_SCHEDULER",    0,  -1, strideenqueue, cfsdequeue,
+                       pickcfs, strideran, 0 },
+[LOTTERY_SCHEDULER]  { "LOTTERY_SCHEDULER",   0,  -1, lotteryenqueue, lotterydequeue,
+                       picklottery, 0, 0 },
+[EDF_SCHEDULER]      { "EDF_SCHEDULER",       1,  -1, edfenqueue, rqremove,
+                       pickedf, edfran, edfpreempts, edftick },
+};
+
+// The policy new processes start under, and that every run
+// queue is switched to by kchsched(). Protected by ptable.lock.
+int curscheduler = SCHEDULER;
+
+// How many processes have ever been queued, on any cpu. If the
+// count has not changed since before nextproc() found nothing,
+// neither has what there is to run. Only a hint without the rq
+// locks.
+static uint
+rqseq(void)
+{
+  uint n;
+  int i;
 
-    highestPriority = 101;
+  n = 0;
+  for(i = 0; i < ncpu; i++)
+    n += runqs[i].nqueued;
+  return n;
+}
 
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    {
-      // here we find the highest priority(which means the lowest value)
-      if(p->state != RUNNABLE)
+// Take the next process to run off c's run queue or, if it is
+// empty, steal one that may run on c from another cpu, the busiest
+// first. Returns 0 if there is nothing to run. Either way, returns
+// with c->rq->lock held.
+static struct proc*
+nextproc(struct cpu *c)
+{
+  struct runq *rq, *victim;
+  struct proc *p;
+  unsigned long long t0;
+  uint tried;
+  int i;
+
+  acquire(&c->rq->lock);
+  t0 = rdtsc();
+  if((p = c->rq->sc->pick(c->rq, -1)) != 0){
+    c->pickcycles += rdtsc() - t0;
+    c->picks++;
+    return p;
+  }
+  release(&c->rq->lock);
+
+  // The unlocked look at nrunnable is only a hint;
+  // pick() checks again under the victim's lock.
+  tried = 1 << (c - cpus);
+  while(p == 0){
+    victim = 0;
+    for(i = 0; i < ncpu; i++){
+      rq = cpus[i].rq;
+      if(((tried >> i) & 1) || !rqready(rq))
         continue;
-      
-      if (p->priority < highestPriority)      
-        highestPriority = p->priority;    
+      if(victim == 0 || rq->nrunnable > victim->nrunnable)
+        victim = rq;
     }
-
-    if(highestPriority == 101)
-    {
-      release(&ptable.lock);
-      continue;
+    if(victim == 0)
+      break;
+    tried |= 1 << (victim - runqs);
+    acquire(&victim->lock);
+    if((p = victim->sc->pick(victim, c - cpus)) != 0){
+      vdetach(victim, p);
+      p->cpu = c - cpus;  // now owned by our rq (see lockprocrq)
     }
+    release(&victim->lock);
+  }
 
-    // round robin for the processes that have same priority
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    {
-      if(p->state != RUNNABLE || p->priority != highestPriority)
-        continue;
+  acquire(&c->rq->lock);
+  if(p)
+    vattach(c->rq, p);
+  return p;
+}
 
-      // Switch to chosen process.  It is the process's job
-      // to release ptable.lock and then reacquire it
-      // before jumping back to us.
-      c->proc = p;
-      switchuvm(p);
-      p->state = RUNNING;
+// Called on each timer tick while p runs on this cpu, with
+// interrupts off. Should p give up the cpu?
+int
+timeslice(struct proc *p)
+{
+  struct schedclass *sc = mycpu()->rq->sc;
 
-      // resumes the inner for loop(the second one)
-      // which means we have round robin for the processes that have same priority
-      swtch(&(c->scheduler), p->context);
-      switchkvm();
+  if(sc->tick)
+    return sc->tick(p);
+  return 1;
+}
 
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
-      c->proc = 0;
+// Nothing c may run is runnable anywhere: zero a free page, or
+// else halt until an interrupt arrives, rather than spinning on
+// the run queue locks. kickidle() sends a wakeup IPI when it
+// queues work c may run, and the timer still ticks, in time for
+// throttled deadline processes' next period. seq is rqseq() from
+// before nextproc() looked.
+static void
+idle(struct cpu *c, uint seq)
+{
+  // First use the time to zero pages for kzalloc.
+  if(kprezero())
+    return;
 
-      int reschedule = 0;
-      for(int i = 0; i < ncpu; i++)
-      {
-        if(ptable.priorityChanged[i] == 1)
-        {
-          reschedule = 1;
-          ptable.priorityChanged[i] = 0;
-          break;
-        }
-      }
-      
-      if(reschedule == 1)
-      {
-        // we should find the highest priority again
-        break;
-      }
-      else
-      {
-        // if not changed we do round robin for the same priorities
-        continue;
-      }
-    }
-    release(&ptable.lock);
+  cli();
+  xchg(&c->idle, 1);
 
+  // Work queued after nextproc() looked, but before we were
+  // marked idle, did not kick us; look again if there was any.
+  if(rqseq() != seq){
+    c->idle = 0;
+    sti();
+    return;
   }
+
+  stihlt();
+  c->idle = 0;
 }
 
+// Per-CPU process scheduler.
+// Each CPU calls scheduler() after setting itself up.
+// Scheduler never returns.  It loops, doing:
+//  - choose a process to run, using the scheduling class of
+//    this CPU's run queue, or steal one from a busier CPU,
+//    or halt until there is one
+//  - swtch to start running that process
+//  - eventually that process transfers control
+//      via swtch back to the scheduler.
+//  - let the class update the process, if it wants to.
 void
-mlq_scheduler(void)
+scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  unsigned long long t0;
+  uint seq;
+  int cpu;
   c->proc = 0;
-  
+
   for(;;){
     // Enable interrupts on this processor.
     sti();
 
-    acquire(&ptable.lock);
-
-    if(ptable.queue[0] > 0)
-    {
-      // service the first queue
-      // guaranteed scheduling policy
-
-      struct proc *p1 = 0;
-      float minRatio, ratio;
-      int entitled;
-
-      for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-      {
-        if(p->state != RUNNABLE || p->priority != 1)
-          continue;
-
-        // we found a process which is runnable and belongs to the first queue(priority = 1)
-        if(p1 == 0)
-        {
-          // first one
-          p1 = p;
-          entitled = (float)(ticks - p1->stime) / ptable.queue[0]; // according to the tanenbaum book
-          minRatio = (float)(p1->rtime) / entitled;
-        }
-        else
-        {
-          entitled = (float)(ticks - p->stime) / ptable.queue[0]; // according to the tanenbaum book
-          ratio = (float)(p->rtime) / entitled;
-          if(minRatio > ratio)
-          {
-            p1 = p;
-            minRatio = ratio;
-          }
-        }
-      }
-
-      // we found the minRatio to service
-      c->proc = p1;
-      switchuvm(p1);
-      p1->state = RUNNING;
-
-      swtch(&(c->scheduler), p1->context);   // resumes the for loop - we come here from the exit or the yield by means of the sched function.
-      switchkvm();
-
-      ptable.queue[0]--;
-      if(p1->state != ZOMBIE)
-      {
-        // go to the second queue
-        p1->priority = 2;
-        ptable.queue[1]++;
-      }
-
-      c->proc = 0;
-    }
-    else if(ptable.queue[1] > 0)
-    {
-      // service the second queue
-      // FIFO and RR
-
-      struct proc *p1 = 0;
-      uint minStartTime;
-
-      for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-      {
-        if(p->state != RUNNABLE || p->priority != 2)
-          continue;
-
-        if(p1 == 0)
-        {
-          // first one
-          p1 = p;
-          minStartTime = p1->stime;
-        }
-        else if(minStartTime > p->stime)
-        {
-          p1 = p;
-          minStartTime = p->stime;
-        }
-      }
-
-      c->proc = p1;
-      switchuvm(p1);
-      p1->state = RUNNING;
-
-      swtch(&(c->scheduler), p1->context);   // resumes the for loop
-      switchkvm();
-
-      ptable.queue[1]--;
-      if(p1->state != ZOMBIE)
-      {
-        // go to the third queue
-        p1->priority = 3;
-        ptable.queue[2]++;
-      }
-
-      c->proc = 0;
+    seq = rqseq();
+    p = nextproc(c);
+    if(p == 0){
+      release(&c->rq->lock);
+      idle(c, seq);
+      continue;
     }
-    else if(ptable.queue[2] > 0)
-    {
-      // service the third queue
-      // Round Robin
-
-      for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-      {
-        if(p->state != RUNNABLE || p->priority != 3)
-          continue;
-
-        c->proc = p;
-        switchuvm(p);
-        p->state = RUNNING;
-
-        swtch(&(c->scheduler), p->context);   // resumes the for loop
-        switchkvm();
-
-        if(p->state == ZOMBIE)
-        {
-          ptable.queue[2]--;
-        }
-
-        c->proc = 0;
-        break;  // we should check from the first queue
-      }
+    if(!canrun(p, c - cpus)){
+      // p's affinity changed since it was queued here.
+      cpu = allowedcpu(p);
+      vdetach(c->rq, p);
+      p->cpu = cpu;
+      release(&c->rq->lock);
+      migrate(p, cpu);
+      continue;
     }
-    
-    release(&ptable.lock);
 
+    // Switch to chosen process.  It is the process's job
+    // to release our rq lock and then reacquire it
+    // before jumping back to us.
+    c->proc = p;
+    switchuvm(p);
+    p->state = RUNNING;
+    c->lathist[c->rq->sc - schedclasses]
+      [latbucket(account(p, &p->waitcycles))]++;
+
+    t0 = rdtsc();
+    swtch(&(c->scheduler), p->context);
+    switchkvm();
+
+    // Process is done running for now.
+    // It should have changed its p->state before coming back.
+    c->proc = 0;
+    account(p, &p->runcycles);
+    if(c->rq->sc->ran)
+      c->rq->sc->ran(p, rdtsc() - t0);
+    release(&c->rq->lock);
   }
 }
 
-// Enter scheduler.  Must hold only ptable.lock
+// Enter scheduler.  Must hold only this cpu's rq lock
 // and have changed proc->state. Saves and restores
 // intena because intena is a property of this
 // kernel thread, not this CPU. It should
@@ -688,8 +1642,8 @@ sched(void)
   int intena;
   struct proc *p = myproc();
 
-  if(!holding(&ptable.lock))
-    panic("sched ptable.lock");
+  if(!holding(&mycpu()->rq->lock))
+    panic("sched rq.lock");
   if(mycpu()->ncli != 1)
     panic("sched locks");
   if(p->state == RUNNING)
@@ -705,10 +1659,14 @@ sched(void)
 void
 yield(void)
 {
-  acquire(&ptable.lock);  //DOC: yieldlock
-  myproc()->state = RUNNABLE;
+  struct proc *p = myproc();
+  struct runq *rq;
+
+  rq = lockmyrq();  //DOC: yieldlock
+  p->state = RUNNABLE;
+  rq->sc->enqueue(rq, p);
   sched();
-  release(&ptable.lock);
+  unlockmyrq();
 }
 
 // A fork child's very first scheduling by scheduler()
@@ -717,8 +1675,8 @@ void
 forkret(void)
 {
   static int first = 1;
-  // Still holding ptable.lock from scheduler.
-  release(&ptable.lock);
+  // Still holding our rq lock from scheduler.
+  unlockmyrq();
 
   if (first) {
     // Some initialization functions must be run in the context
@@ -732,6 +1690,41 @@ forkret(void)
   // Return to "caller", actually trapret (see allocproc).
 }
 
+// Sleep queue helpers. Caller must hold ptable.lock.
+
+static uint
+sleephash(void *chan)
+{
+  return (((uint)chan * 2654435761u) >> 16) & (NSLEEPQ - 1);
+}
+
+// Put p, which is going to sleep on p->chan, on its bucket.
+static void
+sleepqinsert(struct proc *p)
+{
+  struct proc **head = &ptable.sleepq[sleephash(p->chan)];
+
+  p->sleepprev = 0;
+  p->sleepnext = *head;
+  if(*head)
+    (*head)->sleepprev = p;
+  *head = p;
+}
+
+// Take p, which is being woken, off its bucket.
+static void
+sleepqremove(struct proc *p)
+{
+  if(p->sleepprev)
+    p->sleepprev->sleepnext = p->sleepnext;
+  else
+    ptable.sleepq[sleephash(p->chan)] = p->sleepnext;
+  if(p->sleepnext)
+    p->sleepnext->sleepprev = p->sleepprev;
+  p->sleepnext = 0;
+  p->sleepprev = 0;
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
@@ -758,11 +1751,21 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->sleepstart = ticks;
+  sleepqinsert(p);
+
+  // Trade ptable.lock for our rq lock. A wakeup from now on
+  // queues us on this cpu, so it has to wait for the switch.
+  lockmyrq();
+  release(&ptable.lock);
 
   sched();
 
   // Tidy up.
+  unlockmyrq();
+  acquire(&ptable.lock);
   p->chan = 0;
+  p->iotime += ticks - p->sleepstart;
 
   // Reacquire original lock.
   if(lk != &ptable.lock){  //DOC: sleeplock2
@@ -777,11 +1780,15 @@ sleep(void *chan, struct spinlock *lk)
 static void
 wakeup1(void *chan)
 {
-  struct proc *p;
+  struct proc *p, *next;
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
-      p->state = RUNNABLE;
+  for(p = ptable.sleepq[sleephash(chan)]; p; p = next){
+    next = p->sleepnext;
+    if(p->chan == chan){
+      sleepqremove(p);
+      makerunnable(p);
+    }
+  }
 }
 
 // Wake up all processes sleeping on chan.
@@ -802,15 +1809,15 @@ kill(int pid)
   struct proc *p;
 
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid){
-      p->killed = 1;
-      // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
-        p->state = RUNNABLE;
-      release(&ptable.lock);
-      return 0;
+  if((p = findproc(pid)) != 0){
+    p->killed = 1;
+    // Wake process from sleep if necessary.
+    if(p->state == SLEEPING){
+      sleepqremove(p);
+      makerunnable(p);
     }
+    release(&ptable.lock);
+    return 0;
   }
   release(&ptable.lock);
   return -1;
@@ -836,7 +1843,7 @@ procdump(void)
   char *state;
   uint pc[10];
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  for(p = ptable.all; p; p = p->allnext){
     if(p->state == UNUSED)
       continue;
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
@@ -860,10 +1867,12 @@ kproc_dump(proc_info proc_infos[], int n)
   int i = 0;
 
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  for(p = ptable.all; p; p = p->allnext){
     if(p->state == RUNNING || p->state == RUNNABLE){
-      proc_infos[i].pid = p->pid;
-      proc_infos[i].memsize = p->sz;
+      if(i < n){
+        proc_infos[i].pid = p->pid;
+        proc_infos[i].memsize = p->sz;
+      }
       i++;
       if(n < i)
       {
@@ -904,6 +1913,7 @@ void
 kcps()
 {
   struct proc *p;
+  uint total, share;
 
   //Enables interrupts on this processor.
   sti();
@@ -912,39 +1922,141 @@ kcps()
   acquire(&ptable.lock);
 
   // add what is the scheduler
-  switch (SCHEDULER)
-  {
-    case MAIN_SCHEDULER:
-      cprintf("Here we are using MAIN_SCHEDULER\n");
-      break;
-    
-    case TEST_SCHEDULER:
-      cprintf("Here we are using TEST_SCHEDULER\n");
-      break;
-
-    case PRIORITY_SCHEDULER:
-      cprintf("Here we are using PRIORITY_SCHEDULER\n");
-      break;
-    
-    case MLQ_SCHEDULER:
-      cprintf("Here we are using MLQ_SCHEDULER\n");
-      break;
-    
-    default:
-      cprintf("Probably wrong number has been selected for SCHEDULER\n");
-      break;
-  }
-
-  cprintf("name \t pid \t state \t\t priority \n");
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  cprintf("Here we are using %s\n", schedclasses[curscheduler].name);
+
+  // share is the percentage of the tickets held by processes that
+  // want the cpu, which is what STRIDE_SCHEDULER and
+  // LOTTERY_SCHEDULER aim for; compare it with rtime.
+  total = 0;
+  for(p = ptable.all; p; p = p->allnext)
+    if(p->state == RUNNING || p->state == RUNNABLE)
+      total += p->tickets;
+
+  cprintf("name \t pid \t state \t\t priority \t tickets \t share \t rtime \t cpu \n");
+  for(p = ptable.all; p; p = p->allnext){
+    share = 0;
+    if((p->state == RUNNING || p->state == RUNNABLE) && total > 0)
+      share = p->tickets * 100 / total;
     if(p->state == SLEEPING)
-      cprintf("%s \t %d \t SLEEPING \t %d \n", p->name,p->pid,p->priority);
+      cprintf("%s \t %d \t SLEEPING \t %d", p->name,p->pid,p->priority);
     else if(p->state == RUNNING)
-      cprintf("%s \t %d \t RUNNING \t %d \n", p->name,p->pid,p->priority);
+      cprintf("%s \t %d \t RUNNING \t %d", p->name,p->pid,p->priority);
     else if(p->state == RUNNABLE)
-      cprintf("%s \t %d \t RUNNABLE \t %d \n", p->name,p->pid,p->priority);
+      cprintf("%s \t %d \t RUNNABLE \t %d", p->name,p->pid,p->priority);
+    else
+      continue;
+    cprintf(" \t\t %d \t\t %d%% \t %d \t %d \n",
+            p->tickets, share, p->rtime, p->cpu);
+  }
+  release(&ptable.lock);
+}
+
+// Make the current process a deadline process that needs runtime
+// ticks of every period ticks, each within deadline ticks of the
+// period's start; a runtime of 0 makes it best effort again.
+// Fails if the reservation would overload the cpus.
+int
+ksetdeadline(int runtime, int period, int deadline)
+{
+  struct proc *p = myproc();
+  struct runq *rq;
+  int util;
+
+  if(runtime == 0)
+    period = deadline = 0;
+  else if(runtime < 0 || runtime > deadline || deadline > period ||
+          period > EDFMAXPERIOD)
+    return -1;
+
+  acquire(&ptable.lock);
+  util = period ? runtime * 1000 / period : 0;
+  if(dlutil - edfutil(p) + util > ncpu * EDFMAXUTIL){
+    release(&ptable.lock);
+    return -1;
+  }
+  dlutil += util - edfutil(p);
+
+  rq = lockprocrq(p);
+  p->dlruntime = runtime;
+  p->dlperiod = period;
+  p->dldeadline = deadline;
+  p->dlnext = ticks;      // first period starts now
+  p->dlremain = 0;
+  p->dldone = 1;
+  release(&rq->lock);
+  release(&ptable.lock);
+
+  // Let the scheduler rank us with the new parameters.
+  yield();
+  return 0;
+}
+
+// Let process pid run only on the cpus in mask.
+// Returns the old mask, or -1.
+int
+ksetaffinity(int pid, uint mask)
+{
+  struct proc *p;
+  struct runq *rq;
+  int old, resched;
+
+  mask &= (1 << ncpu) - 1;
+  if(mask == 0)
+    return -1;
+
+  old = -1;
+  resched = 0;
+  acquire(&ptable.lock);
+  if((p = findproc(pid)) != 0 && p->state != ZOMBIE){
+    rq = lockprocrq(p);
+    old = p->affinity & ((1 << ncpu) - 1);
+    p->affinity = mask;
+    // A queued p moves when its cpu next picks it, a sleeping p
+    // when it wakes up. A running p moves when it gives up the cpu,
+    // so make it do that now.
+    if(p->state == RUNNING && !canrun(p, p->cpu)){
+      if(p == myproc())
+        resched = 1;
+      else
+        lapicipi(cpus[p->cpu].apicid, T_IRQ0 + IRQ_RESCHED);
+    }
+    release(&rq->lock);
   }
   release(&ptable.lock);
+
+  if(resched)
+    yield();
+  return old;
+}
+
+// The cpus process pid may run on, or -1.
+int
+kgetaffinity(int pid)
+{
+  struct proc *p;
+  int mask = -1;
+
+  acquire(&ptable.lock);
+  if((p = findproc(pid)) != 0)
+    mask = p->affinity & ((1 << ncpu) - 1);
+  release(&ptable.lock);
+  return mask;
+}
+
+// Give the current process n tickets.
+int
+ksettickets(int n)
+{
+  struct proc *p = myproc();
+  struct runq *rq;
+
+  if(n < 1 || n > MAXTICKETS)
+    return -1;
+  // Under the owning rq lock, as lotterydequeue subtracts them.
+  rq = lockprocrq(p);
+  p->tickets = n;
+  release(&rq->lock);
+  return 0;
 }
 
 int 
@@ -954,19 +2066,10 @@ kchpr(int pid, int priority)
   int oldPriority = -1;
 
 	acquire(&ptable.lock);
-	for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-	  if(p->pid == pid){
-      oldPriority = p->priority;
-			p->priority = priority;
-			break;
-		}
+	if((p = findproc(pid)) != 0){
+    oldPriority = p->priority;
+		setpriority(p, priority);
 	}
-
-  for(int i = 0; i < ncpu; i++)
-  {
-    // we should inform every cpu to reschedule.
-    ptable.priorityChanged[i] = 1;
-  }
 	release(&ptable.lock);
 
   yield();
@@ -974,8 +2077,130 @@ kchpr(int pid, int priority)
 	return oldPriority;
 }
 
+// Switch every cpu to scheduling class n while the system runs.
+// Each run queue is rebuilt under the new class, and every process
+// restarts at the new class's initial priority, since priorities
+// mean different things to different classes.
+// Returns the previous class, or -1 if n is not a class.
+int
+kchsched(int n)
+{
+  struct schedclass *sc;
+  struct runq *rq;
+  struct proc *p, *list, **last;
+  int i, old;
+
+  if(n <= 0 || n >= NELEM(schedclasses) || schedclasses[n].name == 0)
+    return -1;
+  sc = &schedclasses[n];
+
+  acquire(&ptable.lock);
+  old = curscheduler;
+  curscheduler = n;
+
+  for(i = 0; i < NCPU; i++){
+    rq = &runqs[i];
+    acquire(&rq->lock);
+    // Take every queued process off, whatever the old class
+    // would pick next; pick() skips throttled EDF processes.
+    list = 0;
+    last = &list;
+    for(p = ptable.all; p; p = p->allnext){
+      if(p->onrq && p->cpu == i){
+        rq->sc->dequeue(rq, p);
+        *last = p;
+        last = &p->rqnext;
+      }
+    }
+    *last = 0;
+    rq->sc = sc;
+    rq->nthrottled = 0;
+    while((p = list) != 0){
+      list = p->rqnext;
+      sc->enqueue(rq, p);
+    }
+    release(&rq->lock);
+  }
+
+  // Reservations made under EDF_SCHEDULER end with it; a
+  // process that wants one again asks setdeadline() anew.
+  if(old == EDF_SCHEDULER && n != EDF_SCHEDULER){
+    for(p = ptable.all; p; p = p->allnext){
+      p->dlruntime = 0;
+      p->dlperiod = 0;
+      p->dldeadline = 0;
+    }
+    dlutil = 0;
+  }
+
+  for(p = ptable.all; p; p = p->allnext)
+    if(p->state != UNUSED)
+      setpriority(p, sc->initprio);
+  release(&ptable.lock);
+
+  return old;
+}
+
+// TSC cycles in thousandths of a clock tick.
+static uint
+cyclestomticks(unsigned long long cycles)
+{
+  uint d = tscpertick / 1000;
+
+  if(d == 0)
+    return 0;   // not calibrated yet
+  if((cycles >> 32) >= d)
+    return ~0;
+  return divl(cycles >> 32, (uint)cycles, d);
+}
+
+// Fill *ru with p's times, counting the time it has spent in its
+// current state so far. Caller must hold ptable.lock; the counts
+// of a process that changes state meanwhile may be off a little.
+static void
+fillrusage(struct proc *p, struct rusage *ru)
+{
+  unsigned long long run, wait, sleep, now;
+
+  run = p->runcycles;
+  wait = p->waitcycles;
+  sleep = p->sleepcycles;
+  now = rdtsc();
+  if(now > p->tsc){
+    if(p->state == RUNNING)
+      run += now - p->tsc;
+    else if(p->state == RUNNABLE)
+      wait += now - p->tsc;
+    else if(p->state == SLEEPING)
+      sleep += now - p->tsc;
+  }
+  ru->runtime = cyclestomticks(run);
+  ru->waittime = cyclestomticks(wait);
+  ru->sleeptime = cyclestomticks(sleep);
+}
+
+// Fill *ru for process pid, or for the caller if pid is 0.
+int
+kgetrusage(int pid, struct rusage *ru)
+{
+  struct proc *p;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+  acquire(&ptable.lock);
+  if((p = findproc(pid)) != 0){
+    fillrusage(p, ru);
+    release(&ptable.lock);
+    return 0;
+  }
+  release(&ptable.lock);
+  return -1;
+}
+
+// Wait for a child to exit and return its pid, or -1. Any of the
+// pointers may be 0; the others get the child's times and counts.
 int
-kwaitx(int *wtime, int *rtime)
+kwaitx(int *wtime, int *rtime, int *misses, struct rusage *ru)
 {
   struct proc *p;
   int havekids, pid;
@@ -983,26 +2208,30 @@ kwaitx(int *wtime, int *rtime)
   
   acquire(&ptable.lock);
   for(;;){
-    // Scan through table looking for exited children.
+    // Scan through our children looking for exited ones.
     havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
+    for(p = curproc->child; p; p = p->nextsib){
       havekids = 1;
       if(p->state == ZOMBIE){
         // Found one.
         pid = p->pid;
-        kfree(p->kstack);
-        p->kstack = 0;
+        rqsync(p);
         freevm(p->pgdir);
+        pidunhash(p);
+        delchild(p);
         p->pid = 0;
-        p->parent = 0;
         p->name[0] = 0;
         p->killed = 0;
-        p->state = UNUSED;
+        freeproc(p);   // keeps p->kstack for the next process
 
-        *wtime = (p->etime - p->stime) - p->rtime;  // set the waiting time of the child
-        *rtime = p->rtime;    // set the run time of child
+        if(wtime)
+          *wtime = (p->etime - p->stime) - p->rtime;  // set the waiting time of the child
+        if(rtime)
+          *rtime = p->rtime;    // set the run time of child
+        if(misses)
+          *misses = p->dlmisses;  // EDF_SCHEDULER deadline misses
+        if(ru)
+          fillrusage(p, ru);     // TSC-measured times of the child
 
         release(&ptable.lock);
         return pid;
@@ -1027,12 +2256,7 @@ kset_priority(int priority)
 
   acquire(&ptable.lock);
   int oldPriority = curproc->priority;
-  curproc->priority = priority;
-  for(int i = 0; i < ncpu; i++)
-  {
-    // we should inform every cpu to reschedule.
-    ptable.priorityChanged[i] = 1;
-  }
+  setpriority(curproc, priority);
   release(&ptable.lock);
 
   yield();
@@ -1040,30 +2264,74 @@ kset_priority(int priority)
   return oldPriority;
 }
 
-// This method will run every clock tick and update the statistic fields for each proc
+// This method will run every clock tick on every cpu, with
+// interrupts off, and charge the tick to what this cpu is running.
+// Only this cpu changes the running process's rtime, so no lock is
+// needed. I/O time is not counted here: sleep() adds it up from
+// timestamps when the process wakes.
 void
 updateStatistics() 
 {
-  struct proc *p;
+  struct proc *p = myproc();
 
-  acquire(&ptable.lock);
+  if(p == 0)
+    mycpu()->idleticks++;
+  else
+    p->rtime++;
+}
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-  {
-    switch(p->state)
-    {
-      case SLEEPING:
-        p->iotime++;
-        break;
-      case RUNNABLE:
-        break;
-      case RUNNING:
-        p->rtime++;
-        break;
-      default:
-        break;
+// Copy the scheduler statistics of up to n cpus into cpu_infos
+// and return how many were copied. If reset is non-zero, the
+// counters start again from zero.
+int
+kcpustat(cpu_info cpu_infos[], int n, int reset)
+{
+  struct cpu *c;
+  int i;
+
+  for(i = 0; i < n && i < ncpu; i++){
+    c = &cpus[i];
+    cpu_infos[i].cpu = i;
+    cpu_infos[i].picks = c->picks;
+    cpu_infos[i].pickcycles = c->pickcycles;
+    cpu_infos[i].idleticks = c->idleticks;
+    if(reset){
+      c->picks = 0;
+      c->pickcycles = 0;
+      c->idleticks = 0;
     }
   }
+  return i;
+}
 
-  release(&ptable.lock);
+// Add the scheduling latency histograms of cpu (all cpus if cpu
+// is -1) for scheduling class sched (all classes if sched is 0)
+// into hist[NLATBUCKET]. If reset is non-zero, the histograms
+// that were read start again from zero. The counters are updated
+// without a lock by the cpu that owns them, so a concurrent read
+// may miss a few counts.
+int
+kschedlat(uint *hist, int cpu, int sched, int reset)
+{
+  struct cpu *c;
+  int i, k;
+
+  if(cpu < -1 || cpu >= ncpu || sched < 0 || sched >= NSCHED)
+    return -1;
+
+  memset(hist, 0, NLATBUCKET * sizeof(hist[0]));
+  for(c = cpus; c < cpus+ncpu; c++){
+    if(cpu >= 0 && c != &cpus[cpu])
+      continue;
+    for(i = 1; i < NSCHED; i++){
+      if(sched > 0 && i != sched)
+        continue;
+      for(k = 0; k < NLATBUCKET; k++){
+        hist[k] += c->lathist[i][k];
+        if(reset)
+          c->lathist[i][k] = 0;
+      }
+    }
+  }
+  return 0;
 }
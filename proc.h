@@ -8,6 +8,14 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  struct runq *rq;             // This cpu's queue of RUNNABLE processes
+  uint picks;                  // Processes picked from rq (see kcpustat)
+  uint pickcycles;             // TSC cycles spent picking them
+  volatile uint idle;          // Halted in idle(), waiting for a wakeup IPI
+  uint idleticks;              // Timer ticks that found no process running
+  uint lathist[NSCHED][NLATBUCKET]; // Scheduling latency of the processes
+                               // we picked, per class: bucket k counts
+                               // waits of 2^k..2^(k+1)-1 TSC cycles
 };
 
 extern struct cpu cpus[NCPU];
@@ -34,6 +42,15 @@ struct context {
 
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// A program segment that exec left to be read from the
+// program file page by page, when first touched (see pagein).
+struct execseg {
+  uint va;                     // Start, page aligned
+  uint off;                    // Offset in the program file
+  uint filesz;                 // Bytes from the file; zeros follow
+  int writable;
+};
+
 // Per-process state
 struct proc {
   uint sz;                     // Size of process memory (bytes)
@@ -42,18 +59,57 @@ struct proc {
   enum procstate state;        // Process state
   int pid;                     // Process ID
   struct proc *parent;         // Parent process
+  struct proc *child;          // First of our children (see proc.c)
+  struct proc *nextsib;        // Other children of our parent
+  struct proc *prevsib;
+  struct proc *pidnext;        // Pid hash chain (see proc.c)
+  struct proc *allnext;        // Process table links (see proc.c)
+  struct proc *freenext;
   struct trapframe *tf;        // Trap frame for current syscall
   struct context *context;     // swtch() here to run process
   void *chan;                  // If non-zero, sleeping on chan
   int killed;                  // If non-zero, have been killed
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct inode *execip;        // Program file, if segments are paged in
+  int nseg;                    // Segments in seg
+  struct execseg seg[NEXECSEG];
+  struct vma *vmas;            // Mapped regions (see mmap.c)
   char name[16];               // Process name (debugging)
   int priority;
   int stime;                   // Start time
   int etime;                   // End time
   int rtime;                   // Run time
   int iotime;                  // I/O time
+  uint sleepstart;             // When we last went to sleep
+  unsigned long long tsc;      // TSC at our last state change
+  unsigned long long runcycles;   // TSC cycles spent RUNNING,
+  unsigned long long waitcycles;  // RUNNABLE,
+  unsigned long long sleepcycles; // and SLEEPING
+  int cpu;                     // Index of the cpu whose run queue owns us;
+                               // while we sleep, the cpu we last ran on
+  uint affinity;               // Bitmask of the cpus we may run on
+  int onrq;                    // If non-zero, waiting on runqs[cpu]
+  struct proc *rqnext;         // Run queue links (see proc.c)
+  struct proc *rqprev;
+  struct proc *sleepnext;      // Sleep queue links (see proc.c)
+  struct proc *sleepprev;
+  unsigned long long vruntime; // CFS_SCHEDULER: weighted TSC cycles run,
+                               // STRIDE_SCHEDULER: pass
+  struct proc *vleft;          // CFS_SCHEDULER: run queue tree links
+  struct proc *vright;
+  struct proc *vparent;
+  int slice;                   // MLFQ_SCHEDULER: ticks used at this level
+  uint epoch;                  // MLFQ_SCHEDULER: boost period of the level
+  uint tickets;                // STRIDE and LOTTERY_SCHEDULER: cpu share
+  int dlruntime;               // EDF_SCHEDULER: ticks of cpu per period,
+  int dlperiod;                //   or a period of 0 for best effort
+  int dldeadline;              //   relative to the start of a period
+  uint dlabs;                  // Absolute deadline of the current job
+  uint dlnext;                 // Start of the next period
+  int dlremain;                // Runtime left in this period
+  int dldone;                  // Current job is done (process blocked)
+  int dlmisses;                // Jobs that ended after their deadline
 };
 
 // Process memory is laid out contiguously, low addresses first:
@@ -0,0 +1,40 @@
+// an user program for switching the scheduling policy at runtime
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "scheduler.h"
+
+static char *names[] = {
+[MAIN_SCHEDULER]      "main",
+[TEST_SCHEDULER]      "test",
+[PRIORITY_SCHEDULER]  "priority",
+[MLQ_SCHEDULER]       "mlq",
+[CFS_SCHEDULER]       "cfs",
+[MLFQ_SCHEDULER]      "mlfq",
+[STRIDE_SCHEDULER]    "stride",
+[LOTTERY_SCHEDULER]   "lottery",
+[EDF_SCHEDULER]       "edf",
+};
+
+int main(int argc, char *argv[])
+{
+    int i, n, old;
+
+    if(argc != 2){
+        printf(2, "Usage: sched main|priority|mlq|cfs|mlfq|stride|lottery|edf|number\n");
+        exit();
+    }
+
+    n = atoi(argv[1]);
+    for(i = 1; i < sizeof(names)/sizeof(names[0]); i++)
+        if(strcmp(argv[1], names[i]) == 0)
+            n = i;
+
+    if((old = chsched(n)) < 0){
+        printf(2, "sched: no scheduler %s\n", argv[1]);
+        exit();
+    }
+    printf(1, "scheduler %s -> %s\n", names[old], names[n]);
+    exit();
+}
@@ -0,0 +1,86 @@
+// a user program for showing scheduling latency histograms: how
+// long processes waited on a run queue before a cpu ran them
+// usage: schedlat [-r] [-c cpu] [-s scheduler]
+//   with neither -c nor -s, one histogram per cpu and per scheduler;
+//   -r resets the histograms after printing
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define BARWIDTH 40
+
+static void
+printhist(char *what, int n, uint *hist)
+{
+    uint total, max;
+    int k, i, len;
+
+    total = max = 0;
+    for(k = 0; k < NLATBUCKET; k++)
+    {
+        total += hist[k];
+        if(hist[k] > max)
+            max = hist[k];
+    }
+    if(total == 0)
+        return;
+
+    printf(1, "%s %d: %d picks\n", what, n, total);
+    for(k = 0; k < NLATBUCKET; k++)
+    {
+        if(hist[k] == 0)
+            continue;
+        len = hist[k] * BARWIDTH / max;
+        printf(1, "  >= 2^%d cycles \t %d \t", k, hist[k]);
+        for(i = 0; i < len || i == 0; i++)
+            printf(1, "#");
+        printf(1, "\n");
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint hist[NLATBUCKET];
+    int i, cpu, sched, reset;
+
+    cpu = -1;
+    sched = 0;
+    reset = 0;
+    for(i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-r") == 0)
+            reset = 1;
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            cpu = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            sched = atoi(argv[++i]);
+        else
+        {
+            printf(2, "Usage: schedlat [-r] [-c cpu] [-s scheduler]\n");
+            exit();
+        }
+    }
+
+    if(cpu >= 0 || sched > 0)
+    {
+        if(schedlat(hist, cpu, sched, reset) < 0)
+        {
+            printf(2, "schedlat: no cpu %d or scheduler %d\n", cpu, sched);
+            exit();
+        }
+        printhist(cpu >= 0 ? "cpu" : "scheduler", cpu >= 0 ? cpu : sched, hist);
+        exit();
+    }
+
+    for(i = 0; schedlat(hist, i, 0, 0) == 0; i++)
+        printhist("cpu", i, hist);
+    for(i = 1; i < NSCHED; i++)
+        if(schedlat(hist, -1, i, 0) == 0)
+            printhist("scheduler", i, hist);
+    if(reset)
+        schedlat(hist, -1, 0, 1);
+    exit();
+}
@@ -1,6 +1,7 @@
 // don’t use TEST_SCHEDULER.
 // it’s not compatible with proc changes that we have made
 
+// the policy at boot; chsched() switches it while the system runs
 #define SCHEDULER 3
 
 // scheduler numbers
@@ -8,3 +9,47 @@
 #define TEST_SCHEDULER      2
 #define PRIORITY_SCHEDULER  3
 #define MLQ_SCHEDULER       4
+#define CFS_SCHEDULER       5
+#define MLFQ_SCHEDULER      6
+#define STRIDE_SCHEDULER    7
+#define LOTTERY_SCHEDULER   8
+#define EDF_SCHEDULER       9
+
+// tickets of a new process, and the most settickets() allows.
+// STRIDE_SCHEDULER and LOTTERY_SCHEDULER share the cpu by them.
+#define DEFTICKETS        100
+#define MAXTICKETS      10000
+
+// EDF_SCHEDULER admission control: setdeadline() fails if the
+// runtime/period of all deadline processes would add up to more
+// than EDFMAXUTIL thousandths of a cpu, times the number of cpus.
+#define EDFMAXUTIL        900
+#define EDFMAXPERIOD   100000  // ticks
+
+// run queues keep one FIFO list per priority value,
+// 0 (highest priority) .. NPRIO-1 (lowest priority)
+#define NPRIO             101
+
+// A scheduling class. Every class keeps its runnable processes
+// on the per-cpu run queues in proc.c; its hooks are called with
+// that run queue's lock held.
+struct proc;
+struct runq;
+
+struct schedclass {
+  char *name;
+  int initprio;                           // priority of new processes
+  int maxprio;                            // chpr accepts 0..maxprio, -1 for none
+  void (*enqueue)(struct runq*, struct proc*);
+  void (*dequeue)(struct runq*, struct proc*);
+  struct proc *(*pick)(struct runq*, int); // choose one that may run on
+                                          // cpu int (-1: any), dequeue
+                                          // and return it, or 0
+  void (*ran)(struct proc*, uint);        // after p ran for uint TSC cycles, or 0
+  int (*preempts)(struct proc*, struct proc*); // should p preempt running q? or 0
+  int (*tick)(struct proc*);              // timer tick while p runs: 1 to yield,
+                                          // or 0 to yield on every tick
+};
+
+extern struct schedclass schedclasses[];
+extern int curscheduler;
@@ -0,0 +1,162 @@
+// Shared memory segments.
+//
+// A segment is a set of zeroed pages that processes find by a
+// key. Attaching one maps its pages into a new MAP_SHARED region
+// of the process (see mmap.c), with mappages, so fork shares it
+// and munmap, exit and exec detach it like any other region.
+// The segment table holds one reference to each page and each
+// mapping another, so pages outlive shmrm until the last process
+// detaches.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "mman.h"
+
+struct shmseg {
+  int used;
+  int key;              // 0 for a private segment
+  int npages;
+  char *pages[SHMMAXPG];
+};
+
+struct {
+  struct spinlock lock;
+  struct shmseg seg[NSHM];
+} shmtab;
+
+void
+shminit(void)
+{
+  initlock(&shmtab.lock, "shm");
+}
+
+// Drop the segment's references to its pages, and free it.
+// Caller must hold shmtab.lock.
+static void
+freeseg(struct shmseg *s)
+{
+  int i;
+
+  for(i = 0; i < s->npages; i++)
+    kfree(s->pages[i]);
+  s->used = 0;
+}
+
+// Return the id of the segment with key, creating one of size
+// bytes if there is none, or if key is 0. Returns -1 if the
+// segment exists but is smaller than size, or can't be made.
+int
+kshmget(int key, uint size)
+{
+  struct shmseg *s, *free;
+  int n;
+
+  n = PGROUNDUP(size) / PGSIZE;
+  if(n == 0 || n > SHMMAXPG)
+    return -1;
+
+  acquire(&shmtab.lock);
+  free = 0;
+  for(s = shmtab.seg; s < &shmtab.seg[NSHM]; s++){
+    if(!s->used){
+      if(free == 0)
+        free = s;
+      continue;
+    }
+    if(key != 0 && s->key == key){
+      release(&shmtab.lock);
+      return s->npages < n ? -1 : s - shmtab.seg;
+    }
+  }
+  if((s = free) == 0){
+    release(&shmtab.lock);
+    return -1;
+  }
+  s->used = 1;
+  s->key = key;
+  for(s->npages = 0; s->npages < n; s->npages++){
+    if((s->pages[s->npages] = kzalloc()) == 0){
+      freeseg(s);
+      release(&shmtab.lock);
+      return -1;
+    }
+  }
+  release(&shmtab.lock);
+  return s - shmtab.seg;
+}
+
+// Map segment id into the current process. Returns the
+// address, or -1.
+int
+kshmat(int id)
+{
+  struct proc *curproc = myproc();
+  char *pages[SHMMAXPG];
+  int i, n, va;
+
+  if(id < 0 || id >= NSHM)
+    return -1;
+
+  // Take our references before the segment can go away.
+  acquire(&shmtab.lock);
+  if(!shmtab.seg[id].used){
+    release(&shmtab.lock);
+    return -1;
+  }
+  n = shmtab.seg[id].npages;
+  for(i = 0; i < n; i++){
+    pages[i] = shmtab.seg[id].pages[i];
+    kdup(pages[i]);
+  }
+  release(&shmtab.lock);
+
+  va = kmmap(n*PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, 0, 0);
+  for(i = 0; i < n; i++){
+    if(va == -1 || mappages(curproc->pgdir, (char*)va + i*PGSIZE, PGSIZE,
+                            V2P(pages[i]), PTE_W|PTE_U) < 0)
+      break;
+  }
+  if(i < n){
+    // munmap drops the references of the pages we mapped.
+    if(va != -1)
+      kmunmap(va, n*PGSIZE);
+    for(; i < n; i++)
+      kfree(pages[i]);
+    return -1;
+  }
+  return va;
+}
+
+// Detach the segment attached at va.
+int
+kshmdt(uint va)
+{
+  uint len;
+
+  if((len = mmaplen(myproc(), va)) == 0)
+    return -1;
+  return kmunmap(va, len);
+}
+
+// Remove segment id: nobody can attach it any more, and its
+// pages are freed when the processes that have it detach.
+int
+kshmrm(int id)
+{
+  if(id < 0 || id >= NSHM)
+    return -1;
+  acquire(&shmtab.lock);
+  if(!shmtab.seg[id].used){
+    release(&shmtab.lock);
+    return -1;
+  }
+  freeseg(&shmtab.seg[id]);
+  release(&shmtab.lock);
+  return 0;
+}
@@ -0,0 +1,159 @@
+// a user program for comparing shared memory with a pipe: a
+// producer sends bytes to a consumer through each, and we time
+// how long it takes. The shared memory version is a ring buffer
+// that both sides spin on, so it wants more than one cpu.
+// usage: shmbench [megabytes]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define PGSIZE  4096
+#define CHUNK   4096
+#define SHMSIZE (16*PGSIZE)
+#define RINGSIZE (SHMSIZE - PGSIZE)  // first page holds the indexes
+
+struct ring {
+    volatile uint head;  // bytes written, by the producer
+    volatile uint tail;  // bytes read, by the consumer
+    char pad[PGSIZE - 2*sizeof(uint)];
+    char buf[RINGSIZE];
+};
+
+static char chunk[CHUNK];
+
+static void
+fill(char *p, uint from, int n)
+{
+    int i;
+
+    for(i = 0; i < n; i++)
+        p[i] = (from + i) & 0xff;
+}
+
+static int
+check(char *p, uint from, int n)
+{
+    int i;
+
+    for(i = 0; i < n; i++)
+        if(p[i] != (char)((from + i) & 0xff))
+            return -1;
+    return 0;
+}
+
+static int
+viapipe(uint total)
+{
+    int fds[2], n, start;
+    uint done;
+
+    if(pipe(fds) < 0)
+        return -1;
+    start = uptime();
+    if(fork() == 0)
+    {
+        close(fds[0]);
+        for(done = 0; done < total; done += CHUNK)
+        {
+            fill(chunk, done, CHUNK);
+            if(write(fds[1], chunk, CHUNK) != CHUNK)
+                break;
+        }
+        exit();
+    }
+    close(fds[1]);
+    for(done = 0; done < total; done += n)
+    {
+        // Reads may return less than asked for.
+        if((n = read(fds[0], chunk, CHUNK)) <= 0)
+            break;
+        if(check(chunk, done, n) < 0)
+        {
+            printf(2, "shmbench: pipe data wrong at %d\n", done);
+            break;
+        }
+    }
+    close(fds[0]);
+    wait();
+    return done == total ? uptime() - start : -1;
+}
+
+static int
+viashm(uint total)
+{
+    struct ring *r;
+    int id, n, off, start;
+    uint done;
+
+    if((id = shmget(0, SHMSIZE)) < 0 || (r = shmat(id)) == (void*)-1)
+        return -1;
+    // The segment goes away when we both detach.
+    shmrm(id);
+    r->head = r->tail = 0;
+
+    start = uptime();
+    if(fork() == 0)
+    {
+        for(done = 0; done < total; done += CHUNK)
+        {
+            fill(chunk, done, CHUNK);
+            while(r->head - r->tail > RINGSIZE - CHUNK)
+                ;
+            off = r->head % RINGSIZE;
+            n = RINGSIZE - off < CHUNK ? RINGSIZE - off : CHUNK;
+            memmove(r->buf + off, chunk, n);
+            memmove(r->buf, chunk + n, CHUNK - n);
+            __sync_synchronize();  // data before head
+            r->head += CHUNK;
+        }
+        exit();
+    }
+    for(done = 0; done < total; done += CHUNK)
+    {
+        while(r->head == r->tail)
+            ;
+        __sync_synchronize();  // head before data
+        off = r->tail % RINGSIZE;
+        n = RINGSIZE - off < CHUNK ? RINGSIZE - off : CHUNK;
+        memmove(chunk, r->buf + off, n);
+        memmove(chunk + n, r->buf, CHUNK - n);
+        __sync_synchronize();  // data before tail
+        r->tail += CHUNK;
+        if(check(chunk, done, CHUNK) < 0)
+        {
+            printf(2, "shmbench: shm data wrong at %d\n", done);
+            break;
+        }
+    }
+    wait();
+    shmdt(r);
+    return done == total ? uptime() - start : -1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint total;
+    int t;
+
+    total = (argc > 1 ? atoi(argv[1]) : 8) * 1024 * 1024;
+    if(total == 0)
+    {
+        printf(2, "usage: shmbench [megabytes]\n");
+        exit();
+    }
+
+    t = viapipe(total);
+    if(t < 0)
+        printf(2, "shmbench: pipe failed\n");
+    else
+        printf(1, "pipe: %d bytes in %d ticks\n", total, t);
+
+    t = viashm(total);
+    if(t < 0)
+        printf(2, "shmbench: shared memory failed\n");
+    else
+        printf(1, "shm:  %d bytes in %d ticks\n", total, t);
+    exit();
+}
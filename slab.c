@@ -0,0 +1,192 @@
+// Slab allocator for kernel objects.
+//
+// A cache hands out objects of one size. It carves them out of
+// slabs, one page each, that start with a struct slab and keep
+// their free objects on a list. Slabs with free objects sit on
+// the cache's partial or empty list; full slabs are on no list,
+// since freeing finds an object's slab by rounding its address
+// down to the page. At most one empty slab is kept; others go
+// back to kfree.
+//
+// In front of the slabs, each cpu has a magazine of objects it
+// can allocate and free without the cache lock. An empty
+// magazine is filled half way from the slabs, and a full one
+// is emptied half way back to them, so that a cpu that keeps
+// allocating and freeing takes the lock once every MAGSIZE/2
+// operations at most.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "slab.h"
+
+struct slab {
+  struct slab *next;
+  struct slab *prev;
+  struct obj *free;   // free objects in this slab
+  uint inuse;         // objects handed out
+};
+
+struct obj {
+  struct obj *next;
+};
+
+#define OBJALIGN 8
+#define SLABHDR  ((sizeof(struct slab) + OBJALIGN-1) & ~(OBJALIGN-1))
+
+void
+kcacheinit(struct kcache *c, char *name, uint size)
+{
+  int i;
+
+  size = (size + OBJALIGN-1) & ~(OBJALIGN-1);
+  if(size < sizeof(struct obj) || size > PGSIZE - SLABHDR)
+    panic("kcacheinit");
+  initlock(&c->lock, name);
+  c->name = name;
+  c->size = size;
+  c->perslab = (PGSIZE - SLABHDR) / size;
+  c->partial = 0;
+  c->empty = 0;
+  c->nslabs = 0;
+  c->nempty = 0;
+  for(i = 0; i < NCPU; i++)
+    c->mag[i].n = 0;
+}
+
+static void
+slabpush(struct slab **list, struct slab *s)
+{
+  s->prev = 0;
+  s->next = *list;
+  if(s->next)
+    s->next->prev = s;
+  *list = s;
+}
+
+static void
+slabunlink(struct slab **list, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    *list = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+// Make a new, empty slab for c.
+static struct slab*
+newslab(struct kcache *c)
+{
+  struct slab *s;
+  struct obj *o;
+  char *p;
+  uint i;
+
+  if((p = kalloc()) == 0)
+    return 0;
+  s = (struct slab*)p;
+  s->free = 0;
+  s->inuse = 0;
+  for(i = c->perslab; i > 0; i--){
+    o = (struct obj*)(p + SLABHDR + (i-1)*c->size);
+    o->next = s->free;
+    s->free = o;
+  }
+  c->nslabs++;
+  return s;
+}
+
+// Take an object from c's slabs. Caller must hold c->lock.
+static void*
+getobj(struct kcache *c)
+{
+  struct slab *s;
+  struct obj *o;
+
+  if((s = c->partial) == 0){
+    if((s = c->empty) != 0){
+      slabunlink(&c->empty, s);
+      c->nempty--;
+    } else if((s = newslab(c)) == 0)
+      return 0;
+    slabpush(&c->partial, s);
+  }
+  o = s->free;
+  s->free = o->next;
+  if(++s->inuse == c->perslab)
+    slabunlink(&c->partial, s);
+  return o;
+}
+
+// Give an object back to its slab. Caller must hold c->lock.
+static void
+putobj(struct kcache *c, void *v)
+{
+  struct slab *s;
+  struct obj *o;
+
+  s = (struct slab*)PGROUNDDOWN((uint)v);
+  o = (struct obj*)v;
+  if(s->inuse == c->perslab)
+    slabpush(&c->partial, s);
+  o->next = s->free;
+  s->free = o;
+  if(--s->inuse > 0)
+    return;
+  slabunlink(&c->partial, s);
+  if(c->nempty > 0){
+    c->nslabs--;
+    kfree((char*)s);
+  } else {
+    slabpush(&c->empty, s);
+    c->nempty++;
+  }
+}
+
+// Allocate an object from c.
+// Returns 0 if the memory cannot be allocated.
+void*
+kcachealloc(struct kcache *c)
+{
+  struct magazine *m;
+  void *v;
+
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n == 0){
+    acquire(&c->lock);
+    while(m->n < MAGSIZE/2 && (v = getobj(c)) != 0)
+      m->obj[m->n++] = v;
+    release(&c->lock);
+  }
+  v = 0;
+  if(m->n > 0)
+    v = m->obj[--m->n];
+  popcli();
+  return v;
+}
+
+// Free an object that kcachealloc(c) returned.
+void
+kcachefree(struct kcache *c, void *v)
+{
+  struct magazine *m;
+
+  if((uint)v % OBJALIGN || ((uint)v % PGSIZE) < SLABHDR)
+    panic("kcachefree");
+
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n == MAGSIZE){
+    acquire(&c->lock);
+    while(m->n > MAGSIZE/2)
+      putobj(c, m->obj[--m->n]);
+    release(&c->lock);
+  }
+  m->obj[m->n++] = v;
+  popcli();
+}
@@ -0,0 +1,23 @@
+// Object caches: allocate many small objects of one size
+// out of pages, instead of one page or one table slot each.
+
+#define MAGSIZE 16  // objects a cpu keeps cached, at most
+
+// Objects a cpu freed and may hand out again without taking
+// the cache lock. Only touched by its cpu with interrupts off.
+struct magazine {
+  int n;
+  void *obj[MAGSIZE];
+};
+
+struct kcache {
+  struct spinlock lock; // protects the slab lists and counts
+  char *name;
+  uint size;            // bytes per object
+  uint perslab;         // objects per slab
+  struct slab *partial; // slabs with some objects free
+  struct slab *empty;   // slabs with all objects free
+  uint nslabs;          // slabs allocated
+  uint nempty;          // slabs on the empty list
+  struct magazine mag[NCPU];
+};
@@ -0,0 +1,50 @@
+// a user program for checking that STRIDE_SCHEDULER and
+// LOTTERY_SCHEDULER share the cpu in proportion to tickets.
+// run "sched stride" (or lottery) first; the shares are exact
+// only when the children compete for one cpu (make CPUS=1).
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NCHILD 3
+#define PERIOD 300   // ticks for the children to compete
+
+int
+main(int argc, char *argv[])
+{
+    int tickets[NCHILD] = {100, 200, 300};
+    int pids[NCHILD];
+    int i, j, pid, end, total, wtime, rtime;
+
+    end = uptime() + PERIOD;
+    total = 0;
+    for(i = 0; i < NCHILD; i++)
+    {
+        total += tickets[i];
+        pids[i] = fork();
+        if(pids[i] < 0)
+        {
+            printf(2, "stridetest: fork failed\n");
+            exit();
+        }
+        if(pids[i] == 0)
+        {
+            settickets(tickets[i]);
+            while(uptime() < end)
+                ;   // compete for the cpu
+            exit();
+        }
+    }
+
+    for(i = 0; i < NCHILD; i++)
+    {
+        if((pid = waitx(&wtime, &rtime)) < 0)
+            break;
+        for(j = 0; j < NCHILD; j++)
+            if(pids[j] == pid)
+                printf(1, "pid %d: %d tickets (%d%%), rtime %d\n",
+                       pid, tickets[j], tickets[j] * 100 / total, rtime);
+    }
+    exit();
+}
@@ -21,6 +21,8 @@ fetchint(uint addr, int *ip)
 
   if(addr >= curproc->sz || addr+4 > curproc->sz)
     return -1;
+  if(uvmtouch(addr, 4, 0) < 0)
+    return -1;
   *ip = *(int*)(addr);
   return 0;
 }
@@ -39,6 +41,8 @@ fetchstr(uint addr, char **pp)
   *pp = (char*)addr;
   ep = (char*)curproc->sz;
   for(s = *pp; s < ep; s++){
+    if((s == *pp || (uint)s % PGSIZE == 0) && uvmtouch((uint)s, 1, 0) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
   }
@@ -54,16 +58,23 @@ argint(int n, int *ip)
 
 // Fetch the nth word-sized system call argument as a pointer
 // to a block of memory of size bytes.  Check that the pointer
-// lies within the process address space.
+// lies within the process address space, below sz or in a
+// region from mmap, and, if write is set, that the kernel may
+// write to it there.
 int
-argptr(int n, char **pp, int size)
+argptr(int n, char **pp, int size, int write)
 {
   int i;
   struct proc *curproc = myproc();
  
   if(argint(n, &i) < 0)
     return -1;
-  if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
+  if(size < 0)
+    return -1;
+  if(((uint)i >= curproc->sz || (uint)i+size > curproc->sz) &&
+     !mmapcovers(curproc, i, size))
+    return -1;
+  if(uvmtouch(i, size, write) < 0)
     return -1;
   *pp = (char*)i;
   return 0;
@@ -109,6 +120,23 @@ extern int sys_cps(void);
 extern int sys_chpr(void);
 extern int sys_waitx(void);
 extern int sys_set_priority(void);
+extern int sys_cpustat(void);
+extern int sys_chsched(void);
+extern int sys_settickets(void);
+extern int sys_setdeadline(void);
+extern int sys_waitdl(void);
+extern int sys_setaffinity(void);
+extern int sys_getaffinity(void);
+extern int sys_getrusage(void);
+extern int sys_waitru(void);
+extern int sys_schedlat(void);
+extern int sys_memstat(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
+extern int sys_shmget(void);
+extern int sys_shmat(void);
+extern int sys_shmdt(void);
+extern int sys_shmrm(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]          sys_fork,
@@ -138,6 +166,23 @@ static int (*syscalls[])(void) = {
 [SYS_chpr]          sys_chpr,
 [SYS_waitx]         sys_waitx,
 [SYS_set_priority]  sys_set_priority,
+[SYS_cpustat]       sys_cpustat,
+[SYS_chsched]       sys_chsched,
+[SYS_settickets]    sys_settickets,
+[SYS_setdeadline]   sys_setdeadline,
+[SYS_waitdl]        sys_waitdl,
+[SYS_setaffinity]   sys_setaffinity,
+[SYS_getaffinity]   sys_getaffinity,
+[SYS_getrusage]     sys_getrusage,
+[SYS_waitru]        sys_waitru,
+[SYS_schedlat]      sys_schedlat,
+[SYS_memstat]       sys_memstat,
+[SYS_mmap]          sys_mmap,
+[SYS_munmap]        sys_munmap,
+[SYS_shmget]        sys_shmget,
+[SYS_shmat]         sys_shmat,
+[SYS_shmdt]         sys_shmdt,
+[SYS_shmrm]         sys_shmrm,
 };
 
 void
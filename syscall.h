@@ -26,3 +26,20 @@
 #define SYS_chpr            25
 #define SYS_waitx           26
 #define SYS_set_priority    27
+#define SYS_cpustat         28
+#define SYS_chsched         29
+#define SYS_settickets      30
+#define SYS_setdeadline     31
+#define SYS_waitdl          32
+#define SYS_setaffinity     33
+#define SYS_getaffinity     34
+#define SYS_getrusage       35
+#define SYS_waitru          36
+#define SYS_schedlat        37
+#define SYS_memstat         38
+#define SYS_mmap            39
+#define SYS_munmap          40
+#define SYS_shmget          41
+#define SYS_shmat           42
+#define SYS_shmdt           43
+#define SYS_shmrm           44
@@ -101,27 +101,35 @@ sys_getyear(void)
 }
 
 // proc_dump system call definition
-void
-sys_proc_dump()
+int
+sys_proc_dump(void)
 {
   // extract arguments and send them to proc_dump
   proc_info *ptr_proc_infos;
-  argptr(0, (char **)&ptr_proc_infos, sizeof(ptr_proc_infos));
-
   int n;
-  argint(1, &n);
+
+  if(argint(1, &n) < 0)
+    return -1;
 
   if(n <= 0)
   {
-    return cprintf("proc_dump system call only accepts positive arg!\n");
+    cprintf("proc_dump system call only accepts positive arg!\n");
+    return -1;
   }
   else if (n > NPROC)
   {
-    return cprintf("in proc_dump system call, n must be less than or equal to %d\n", NPROC);
+    cprintf("in proc_dump system call, n must be less than or equal to %d\n", NPROC);
+    return -1;
   }
 
+  // kproc_dump fills the array holding ptable.lock, where it
+  // can't fault, so all n entries must be there and writable.
+  if(argptr(0, (char **)&ptr_proc_infos, n*sizeof(proc_info), 1) < 0)
+    return -1;
+
   // call corresponding function
-  return kproc_dump(ptr_proc_infos, n);
+  kproc_dump(ptr_proc_infos, n);
+  return 0;
 }
 
 void
@@ -134,35 +142,22 @@ int
 sys_chpr(void)
 {
   int pid, priority;
+  struct schedclass *sc;
+
   if(argint(0, &pid) < 0)
     return -1;
   if(argint(1, &priority) < 0)
     return -1;
 
-  if(SCHEDULER == MAIN_SCHEDULER)
+  sc = &schedclasses[curscheduler];
+  if(sc->maxprio < 0)
   {
-    cprintf("Cant change priority with main_scheduler\n");
+    cprintf("Cant change priority with %s\n", sc->name);
     return -1;
   }
-  else if (SCHEDULER == TEST_SCHEDULER)
-  {
-    if(priority > 20 || priority < 0)
-    {
-      cprintf("priority must be beetween 0 and 20\n");
-      return -1;
-    }
-  }
-  else if (SCHEDULER == PRIORITY_SCHEDULER)
-  {
-    if(priority > 100 || priority < 0)
-    {
-      cprintf("priority must be beetween 0 and 100\n");
-      return -1;
-    }
-  }
-  else if (SCHEDULER == MLQ_SCHEDULER)
+  if(priority > sc->maxprio || priority < 0)
   {
-    cprintf("Cant change priority with mlq_scheduler\n");
+    cprintf("priority must be beetween 0 and %d\n", sc->maxprio);
     return -1;
   }
 
@@ -175,28 +170,230 @@ sys_waitx(void)
   int *wtime;
   int *rtime;
 
-  if(argptr(0, (char**)&wtime, sizeof(*wtime)) < 0)
+  if(argptr(0, (char**)&wtime, sizeof(*wtime), 1) < 0)
     return -1;
 
-  if(argptr(1, (char**)&rtime, sizeof(*rtime)) < 0)
+  if(argptr(1, (char**)&rtime, sizeof(*rtime), 1) < 0)
     return -1 ;
 
-  return kwaitx(wtime, rtime);
+  return kwaitx(wtime, rtime, 0, 0);
+}
+
+int
+sys_setaffinity(void)
+{
+  int pid, mask;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+  if(argint(1, &mask) < 0)
+    return -1;
+
+  return ksetaffinity(pid, mask);
+}
+
+int
+sys_getaffinity(void)
+{
+  int pid;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+
+  return kgetaffinity(pid);
+}
+
+// waitx that also reports the child's deadline misses.
+int
+sys_waitdl(void)
+{
+  int *wtime;
+  int *rtime;
+  int *misses;
+
+  if(argptr(0, (char**)&wtime, sizeof(*wtime), 1) < 0)
+    return -1;
+  if(argptr(1, (char**)&rtime, sizeof(*rtime), 1) < 0)
+    return -1;
+  if(argptr(2, (char**)&misses, sizeof(*misses), 1) < 0)
+    return -1;
+
+  return kwaitx(wtime, rtime, misses, 0);
+}
+
+// waitx that reports the child's TSC-measured times.
+int
+sys_waitru(void)
+{
+  struct rusage *ru;
+
+  if(argptr(0, (char**)&ru, sizeof(*ru), 1) < 0)
+    return -1;
+
+  return kwaitx(0, 0, 0, ru);
+}
+
+int
+sys_getrusage(void)
+{
+  int pid;
+  struct rusage *ru;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+  if(argptr(1, (char**)&ru, sizeof(*ru), 1) < 0)
+    return -1;
+
+  return kgetrusage(pid, ru);
 }
 
 int
 sys_set_priority(void)
 {
   int priority;
+  struct schedclass *sc;
 
   if(argint(0, &priority) < 0)
     return -1;
 
-  if(priority < 0 || priority > 100)
+  sc = &schedclasses[curscheduler];
+  if(sc->maxprio < 0)
   {
-    cprintf("Invalid priority value!\n");
+    cprintf("Cant change priority with %s\n", sc->name);
+    return -1;
+  }
+  if(priority > sc->maxprio || priority < 0)
+  {
+    cprintf("priority must be beetween 0 and %d\n", sc->maxprio);
     return -1;
   }
 
   return kset_priority(priority);
 }
+
+int
+sys_cpustat(void)
+{
+  cpu_info *cpu_infos;
+  int n, reset;
+
+  if(argint(1, &n) < 0 || argint(2, &reset) < 0)
+    return -1;
+  if(n <= 0 || n > NCPU)
+    return -1;
+  if(argptr(0, (char**)&cpu_infos, n*sizeof(*cpu_infos), 1) < 0)
+    return -1;
+
+  return kcpustat(cpu_infos, n, reset);
+}
+
+int
+sys_schedlat(void)
+{
+  uint *hist;
+  int cpu, sched, reset;
+
+  if(argptr(0, (char**)&hist, NLATBUCKET * sizeof(*hist), 1) < 0)
+    return -1;
+  if(argint(1, &cpu) < 0)
+    return -1;
+  if(argint(2, &sched) < 0)
+    return -1;
+  if(argint(3, &reset) < 0)
+    return -1;
+
+  return kschedlat(hist, cpu, sched, reset);
+}
+
+int
+sys_memstat(void)
+{
+  uint *nblocks;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > MAXORDER+1)
+    n = MAXORDER+1;
+  if(argptr(0, (char**)&nblocks, n * sizeof(*nblocks), 1) < 0)
+    return -1;
+
+  return kmemstat(nblocks, n);
+}
+
+int
+sys_shmget(void)
+{
+  int key, size;
+
+  if(argint(0, &key) < 0 || argint(1, &size) < 0 || size <= 0)
+    return -1;
+  return kshmget(key, size);
+}
+
+int
+sys_shmat(void)
+{
+  int id;
+
+  if(argint(0, &id) < 0)
+    return -1;
+  return kshmat(id);
+}
+
+int
+sys_shmdt(void)
+{
+  int addr;
+
+  if(argint(0, &addr) < 0)
+    return -1;
+  return kshmdt(addr);
+}
+
+int
+sys_shmrm(void)
+{
+  int id;
+
+  if(argint(0, &id) < 0)
+    return -1;
+  return kshmrm(id);
+}
+
+int
+sys_chsched(void)
+{
+  int n;
+
+  if(argint(0, &n) < 0)
+    return -1;
+
+  return kchsched(n);
+}
+
+int
+sys_settickets(void)
+{
+  int n;
+
+  if(argint(0, &n) < 0)
+    return -1;
+
+  return ksettickets(n);
+}
+
+int
+sys_setdeadline(void)
+{
+  int runtime, period, deadline;
+
+  if(argint(0, &runtime) < 0)
+    return -1;
+  if(argint(1, &period) < 0)
+    return -1;
+  if(argint(2, &deadline) < 0)
+    return -1;
+
+  return ksetdeadline(runtime, period, deadline);
+}
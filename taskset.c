@@ -0,0 +1,33 @@
+// a user program for reading or changing the cpus a process may
+// run on. mask has one bit per cpu: 1 is cpu 0, 2 is cpu 1, 3 both.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+int main(int argc, char *argv[])
+{
+    int pid, mask, old;
+
+    if(argc != 2 && argc != 3){
+        printf(2, "Usage: taskset pid [mask]\n");
+        exit();
+    }
+    pid = atoi(argv[1]);
+
+    if(argc == 2){
+        if((mask = getaffinity(pid)) < 0)
+            printf(2, "taskset: no process %d\n", pid);
+        else
+            printf(1, "pid %d: mask %d\n", pid, mask);
+        exit();
+    }
+
+    mask = atoi(argv[2]);
+    if((old = setaffinity(pid, mask)) < 0){
+        printf(2, "taskset: cannot set pid %d to mask %d\n", pid, mask);
+        exit();
+    }
+    printf(1, "pid %d: mask %d -> %d\n", pid, old, mask);
+    exit();
+}
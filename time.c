@@ -0,0 +1,48 @@
+// a user program for timing a command: how long it ran, waited
+// for a cpu and slept, measured with the TSC, in clock ticks
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+// print thousandths of a tick as ticks with three decimals
+static void
+printmticks(char *what, uint mticks)
+{
+    uint frac = mticks % 1000;
+
+    printf(2, "%s %d.%d%d%d\n", what, mticks / 1000,
+           frac / 100, frac / 10 % 10, frac % 10);
+}
+
+int
+main(int argc, char *argv[])
+{
+    rusage ru;
+    int pid;
+
+    if(argc < 2){
+        printf(2, "Usage: time command [args]\n");
+        exit();
+    }
+
+    pid = fork();
+    if(pid < 0){
+        printf(2, "time: fork failed\n");
+        exit();
+    }
+    if(pid == 0){
+        exec(argv[1], argv + 1);
+        printf(2, "time: exec %s failed\n", argv[1]);
+        exit();
+    }
+
+    if(waitru(&ru) < 0){
+        printf(2, "time: wait failed\n");
+        exit();
+    }
+    printmticks("run  ", ru.runtime);
+    printmticks("wait ", ru.waittime);
+    printmticks("sleep", ru.sleeptime);
+    exit();
+}
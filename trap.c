@@ -14,6 +14,12 @@ extern uint vectors[];  // in vectors.S: array of 256 entry pointers
 struct spinlock tickslock;
 uint ticks;
 
+// TSC cycles per clock tick, measured over the first CALIBTICKS
+// ticks after boot; 0 until then.
+#define CALIBTICKS 16
+uint tscpertick;
+static unsigned long long calibstart;
+
 void
 tvinit(void)
 {
@@ -48,15 +54,32 @@ trap(struct trapframe *tf)
 
   switch(tf->trapno){
   case T_IRQ0 + IRQ_TIMER:
+    updateStatistics();   // charge this cpu's clock tick
     if(cpuid() == 0){
       acquire(&tickslock);
       ticks++;
-      updateStatistics();   // this will update proc statistic every clock tick
+      if(ticks == 1)
+        calibstart = rdtsc();
+      else if(ticks == 1 + CALIBTICKS){
+        // The elapsed cycles overflow 32 bits within seconds
+        // on a fast cpu; only the per-tick quotient fits.
+        calibstart = rdtsc() - calibstart;
+        tscpertick = divl(calibstart >> 32, (uint)calibstart, CALIBTICKS);
+      }
       wakeup(&ticks);
       release(&tickslock);
     }
     lapiceoi();
     break;
+  case T_IRQ0 + IRQ_WAKEUP:
+    // Sent by kickidle() to get us out of hlt; nothing else to do.
+    lapiceoi();
+    break;
+  case T_IRQ0 + IRQ_RESCHED:
+    // Sent by preempt(): a process that outranks ours is waiting
+    // on our run queue. We yield below, as on a timer tick.
+    lapiceoi();
+    break;
   case T_IRQ0 + IRQ_IDE:
     ideintr();
     lapiceoi();
@@ -79,6 +102,16 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
 
+  case T_PGFLT:
+    // A write to a page shared copy-on-write, or the first touch
+    // of a page of the program or of memory from sbrk. Either can
+    // come from the kernel using user memory in a system call, too.
+    if(myproc() && (tf->err & FEC_WR) && cowfault(myproc()->pgdir, rcr2()) == 0)
+      break;
+    if(myproc() && !(tf->err & FEC_PR) && pagein(rcr2()) == 0)
+      break;
+    // fall through
+
   //PAGEBREAK: 13
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
@@ -101,10 +134,12 @@ trap(struct trapframe *tf)
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
 
-  // Force process to give up CPU on clock tick.
+  // Force process to give up CPU when its time slice ends, or
+  // when another cpu asked us to reschedule.
   // If interrupts were on while locks held, would need to check nlock.
   if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER)
+     ((tf->trapno == T_IRQ0+IRQ_TIMER && timeslice(myproc())) ||
+      tf->trapno == T_IRQ0+IRQ_RESCHED))
     yield();
 
   // Check if the process has been killed since we yielded
@@ -16,6 +16,8 @@
 #define T_STACK         12      // stack exception
 #define T_GPFLT         13      // general protection fault
 #define T_PGFLT         14      // page fault
+#define FEC_PR          0x1     // page fault error code: page was present
+#define FEC_WR          0x2     // page fault error code: caused by a write
 // #define T_RES        15      // reserved
 #define T_FPERR         16      // floating point error
 #define T_ALIGN         17      // aligment check
@@ -34,5 +36,7 @@
 #define IRQ_COM1         4
 #define IRQ_IDE         14
 #define IRQ_ERROR       19
+#define IRQ_WAKEUP      20      // IPI: wake a cpu halted in idle()
+#define IRQ_RESCHED     21      // IPI: preempt the running process now
 #define IRQ_SPURIOUS    31
 
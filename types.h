@@ -2,8 +2,23 @@ typedef unsigned int   uint;
 typedef unsigned short ushort;
 typedef unsigned char  uchar;
 typedef uint pde_t;
+typedef uint pte_t;
 
 typedef struct proc_info {
     int pid;
     int memsize; // in bytes 
 } proc_info;
+
+typedef struct cpu_info {
+    int cpu;
+    uint picks;      // processes picked to run by this cpu's scheduler
+    uint pickcycles; // TSC cycles spent picking them
+    uint idleticks;  // timer ticks this cpu spent without a process
+} cpu_info;
+
+// times measured with the TSC, in thousandths of a clock tick
+typedef struct rusage {
+    uint runtime;    // running on a cpu
+    uint waittime;   // runnable, waiting for a cpu
+    uint sleeptime;  // sleeping
+} rusage;
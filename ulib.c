@@ -3,6 +3,7 @@
 #include "fcntl.h"
 #include "user.h"
 #include "x86.h"
+#include "param.h"
 
 char*
 strcpy(char *s, const char *t)
@@ -104,3 +105,17 @@ memmove(void *vdst, const void *vsrc, int n)
     *dst++ = *src++;
   return vdst;
 }
+
+// Free physical pages: those cached per cpu plus
+// those in the buddy allocator's blocks.
+int
+freepages(void)
+{
+  uint nblocks[MAXORDER+1];
+  int k, n;
+
+  n = memstat(nblocks, MAXORDER+1);
+  for(k = 0; k <= MAXORDER; k++)
+    n += nblocks[k] << k;
+  return n;
+}
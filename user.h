@@ -1,6 +1,8 @@
 struct stat;
 struct rtcdate;
 typedef struct proc_info proc_info;
+typedef struct cpu_info cpu_info;
+typedef struct rusage rusage;
 
 // system calls
 int fork(void);
@@ -30,6 +32,23 @@ int cps(void);
 int chpr(int pid, int priority);
 int waitx(int*, int*);
 int set_priority(int);
+int cpustat(cpu_info cpu_infos[], int n, int reset);
+int chsched(int);
+int settickets(int);
+int setdeadline(int runtime, int period, int deadline);
+int waitdl(int*, int*, int*);
+int setaffinity(int pid, uint mask);
+int getaffinity(int pid);
+int getrusage(int pid, rusage*);
+int waitru(rusage*);
+int schedlat(uint *hist, int cpu, int sched, int reset);
+int memstat(uint *nblocks, int n);
+void* mmap(void *addr, uint len, int prot, int flags, int fd, uint off);
+int munmap(void *addr, uint len);
+int shmget(int key, uint size);
+void* shmat(int id);
+int shmdt(void *addr);
+int shmrm(int id);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -44,3 +63,4 @@ void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
 int atoi(const char*);
+int freepages(void);
@@ -32,7 +32,7 @@ seginit(void)
 // Return the address of the PTE in page table pgdir
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page table pages.
-static pte_t *
+pte_t *
 walkpgdir(pde_t *pgdir, const void *va, int alloc)
 {
   pde_t *pde;
@@ -42,10 +42,9 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
   if(*pde & PTE_P){
     pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
   } else {
-    if(!alloc || (pgtab = (pte_t*)kalloc()) == 0)
-      return 0;
     // Make sure all those PTE_P bits are zero.
-    memset(pgtab, 0, PGSIZE);
+    if(!alloc || (pgtab = (pte_t*)kzalloc()) == 0)
+      return 0;
     // The permissions here are overly generous, but they can
     // be further restricted by the permissions in the page table
     // entries, if necessary.
@@ -57,7 +56,7 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
 // be page-aligned.
-static int
+int
 mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
 {
   char *a, *last;
@@ -121,9 +120,8 @@ setupkvm(void)
   pde_t *pgdir;
   struct kmap *k;
 
-  if((pgdir = (pde_t*)kalloc()) == 0)
+  if((pgdir = (pde_t*)kzalloc()) == 0)
     return 0;
-  memset(pgdir, 0, PGSIZE);
   if (P2V(PHYSTOP) > (void*)DEVSPACE)
     panic("PHYSTOP too high");
   for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
@@ -186,8 +184,7 @@ inituvm(pde_t *pgdir, char *init, uint sz)
 
   if(sz >= PGSIZE)
     panic("inituvm: more than a page");
-  mem = kalloc();
-  memset(mem, 0, PGSIZE);
+  mem = kzalloc();
   mappages(pgdir, 0, PGSIZE, V2P(mem), PTE_W|PTE_U);
   memmove(mem, init, sz);
 }
@@ -231,13 +228,12 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 
   a = PGROUNDUP(oldsz);
   for(; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    mem = kzalloc();
     if(mem == 0){
       cprintf("allocuvm out of memory\n");
       deallocuvm(pgdir, newsz, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
       cprintf("allocuvm out of memory (2)\n");
       deallocuvm(pgdir, newsz, oldsz);
@@ -310,37 +306,164 @@ clearpteu(pde_t *pgdir, char *uva)
   *pte &= ~PTE_U;
 }
 
+// Map the pages of [start, end) that pgdir has into d too.
+// Unless shared is set, writable pages become read-only with
+// PTE_COW in both, and cowfault gives a process its own copy
+// when it writes. pgdir must be the current page table.
+// Returns -1 if out of memory.
+int
+uvmshare(pde_t *pgdir, pde_t *d, uint start, uint end, int shared)
+{
+  pte_t *pte;
+  uint pa, i, flags;
+
+  for(i = start; i < end; i += PGSIZE){
+    // Skip memory that was never touched.
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
+      continue;
+    if(!(*pte & PTE_P))
+      continue;
+    if(!shared && (*pte & PTE_W))
+      *pte = (*pte & ~PTE_W) | PTE_COW;
+    pa = PTE_ADDR(*pte);
+    // d has not written the page, and must not write it back.
+    flags = PTE_FLAGS(*pte) & ~PTE_D;
+    if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0){
+      lcr3(V2P(pgdir));
+      return -1;
+    }
+    kdup(P2V(pa));
+  }
+  lcr3(V2P(pgdir));  // flush the write permissions we took away
+  return 0;
+}
+
 // Given a parent process's page table, create a copy
-// of it for a child.
+// of it for a child. The pages themselves are not copied,
+// but shared copy-on-write. pgdir must be the current
+// page table.
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
   pde_t *d;
-  pte_t *pte;
-  uint pa, i, flags;
-  char *mem;
 
   if((d = setupkvm()) == 0)
     return 0;
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
-    if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
-    pa = PTE_ADDR(*pte);
-    flags = PTE_FLAGS(*pte);
+  if(uvmshare(pgdir, d, 0, sz, 0) < 0){
+    freevm(d);
+    return 0;
+  }
+  return d;
+}
+
+// Handle a write to the copy-on-write page at va: give pgdir
+// a private, writable copy of it, or, if pgdir is its only
+// owner left, just make it writable again.
+// Returns -1 if va is not a copy-on-write page or there is
+// no memory for the copy.
+int
+cowfault(pde_t *pgdir, uint va)
+{
+  pte_t *pte;
+  uint pa, flags;
+  char *mem;
+
+  if(va >= KERNBASE)
+    return -1;
+  if((pte = walkpgdir(pgdir, (char*)va, 0)) == 0)
+    return -1;
+  if((*pte & (PTE_P|PTE_COW)) != (PTE_P|PTE_COW))
+    return -1;
+  pa = PTE_ADDR(*pte);
+  flags = (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W;
+  if(kowners(P2V(pa)) > 1){
     if((mem = kalloc()) == 0)
-      goto bad;
+      return -1;
     memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
-      kfree(mem);
-      goto bad;
-    }
+    *pte = V2P(mem) | flags;
+    kfree(P2V(pa));
+  } else
+    *pte = pa | flags;
+  if(myproc() && myproc()->pgdir == pgdir)
+    lcr3(V2P(pgdir));  // flush the old read-only entry
+  return 0;
+}
+
+// Map the page at va that the current process has not touched
+// yet. Pages above sz belong to mmap regions; see mmapfault.
+// Pages of a program segment that exec left to be read on demand
+// come from the program file's text cache, shared with other
+// processes running it; writable segments map them copy-on-write.
+// Other pages, from sbrk or a program's bss, are zero filled.
+// Returns -1 if va is not such a page or the page can't be had.
+int
+pagein(uint va)
+{
+  struct proc *curproc = myproc();
+  struct execseg *s;
+  pte_t *pte;
+  char *mem;
+  uint flags, n;
+
+  if(va >= KERNBASE)
+    return -1;
+  if((pte = walkpgdir(curproc->pgdir, (char*)va, 0)) != 0 && (*pte & PTE_P))
+    return -1;
+  if(va >= curproc->sz)
+    return mmapfault(va);
+  va = PGROUNDDOWN(va);
+
+  mem = 0;
+  flags = PTE_W|PTE_U;
+  for(s = curproc->seg; s < &curproc->seg[curproc->nseg]; s++){
+    if(va < s->va || va >= s->va + s->filesz)
+      continue;
+    n = s->filesz - (va - s->va);
+    if(n > PGSIZE)
+      n = PGSIZE;
+    ilock(curproc->execip);
+    mem = itextpage(curproc->execip, s->off + (va - s->va), n);
+    iunlock(curproc->execip);
+    if(mem == 0)
+      return -1;
+    flags = s->writable ? PTE_COW|PTE_U : PTE_U;
+    break;
   }
-  return d;
+  if(mem == 0 && (mem = kzalloc()) == 0)
+    return -1;
+  if(mappages(curproc->pgdir, (char*)va, PGSIZE, V2P(mem), flags) < 0){
+    kfree(mem);
+    return -1;
+  }
+  return 0;
+}
 
-bad:
-  freevm(d);
+// Map any untouched pages in [va, va+n) of the current process,
+// so that the kernel can use that memory without faulting. If
+// write is set, also give it its own copy of copy-on-write pages.
+// Returns -1 if they can't be had, or the process may not use
+// them that way, e.g. a write to a read-only mapping.
+int
+uvmtouch(uint va, uint n, int write)
+{
+  struct proc *curproc = myproc();
+  pte_t *pte;
+  uint a;
+
+  for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE){
+    pte = walkpgdir(curproc->pgdir, (char*)a, 0);
+    if(pte == 0 || !(*pte & PTE_P)){
+      if(pagein(a) < 0)
+        return -1;
+      pte = walkpgdir(curproc->pgdir, (char*)a, 0);
+    }
+    if(!(*pte & PTE_U))
+      return -1;
+    if(write && !(*pte & PTE_W)){
+      if(!(*pte & PTE_COW) || cowfault(curproc->pgdir, a) < 0)
+        return -1;
+    }
+  }
   return 0;
 }
 
@@ -352,7 +475,7 @@ uva2ka(pde_t *pgdir, char *uva)
   pte_t *pte;
 
   pte = walkpgdir(pgdir, uva, 0);
-  if((*pte & PTE_P) == 0)
+  if(pte == 0 || (*pte & PTE_P) == 0)
     return 0;
   if((*pte & PTE_U) == 0)
     return 0;
@@ -362,6 +485,8 @@ uva2ka(pde_t *pgdir, char *uva)
 // Copy len bytes from p to user address va in page table pgdir.
 // Most useful when pgdir is not the current page table.
 // uva2ka ensures this only works for PTE_U pages.
+// Writes go through the kernel mapping, so copy-on-write
+// pages must be copied here rather than on a fault.
 int
 copyout(pde_t *pgdir, uint va, void *p, uint len)
 {
@@ -374,6 +499,11 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
     pa0 = uva2ka(pgdir, (char*)va0);
     if(pa0 == 0)
       return -1;
+    if(*walkpgdir(pgdir, (char*)va0, 0) & PTE_COW){
+      if(cowfault(pgdir, va0) < 0)
+        return -1;
+      pa0 = uva2ka(pgdir, (char*)va0);
+    }
     n = PGSIZE - (va - va0);
     if(n > len)
       n = len;
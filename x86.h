@@ -117,6 +117,15 @@ sti(void)
   asm volatile("sti");
 }
 
+// Enable interrupts and halt until the next one arrives.
+// sti only takes effect after the following instruction, so an
+// interrupt cannot be taken between the two and missed by hlt.
+static inline void
+stihlt(void)
+{
+  asm volatile("sti; hlt");
+}
+
 static inline uint
 xchg(volatile uint *addr, uint newval)
 {
@@ -130,6 +139,25 @@ xchg(volatile uint *addr, uint newval)
   return result;
 }
 
+// Read the time-stamp counter.
+static inline unsigned long long
+rdtsc(void)
+{
+  unsigned long long t;
+  asm volatile("rdtsc" : "=A" (t));
+  return t;
+}
+
+// (hi:lo) / d, for 64-bit values without libgcc.
+// The quotient must fit in 32 bits, so hi must be less than d.
+static inline uint
+divl(uint hi, uint lo, uint d)
+{
+  uint q, r;
+  asm volatile("divl %4" : "=a" (q), "=d" (r) : "a" (lo), "d" (hi), "rm" (d));
+  return q;
+}
+
 static inline uint
 rcr2(void)
 {